@@ -0,0 +1,56 @@
+#include "AdmissionControl.hpp"
+
+#include <algorithm>
+
+#include "../myPoller/EventPoller.hpp"
+#include "Util/TimeTicker.h"
+
+namespace myNet {
+
+AdmissionControl::AdmissionControl(const Config& config) : _config(config) {
+    if (_config.acceptBurst == 0) {
+        _config.acceptBurst = std::max<size_t>(1, static_cast<size_t>(_config.acceptRate));
+    }
+    _tokens = _config.acceptBurst;
+    _lastRefillMs = toolkit::getCurrentMillisecond();
+}
+
+AdmissionControl::Verdict AdmissionControl::check() {
+    if (_config.maxSessions && _sessions.load() >= _config.maxSessions) {
+        return Verdict::MaxSessions;
+    }
+    if (_config.maxLoad && isOverload()) {
+        return Verdict::Overload;
+    }
+    if (_config.acceptRate > 0 && !takeToken()) {
+        return Verdict::RateLimited;
+    }
+    return Verdict::Accept;
+}
+
+bool AdmissionControl::takeToken() {
+    std::lock_guard<std::mutex> lck(_mtxBucket);
+    auto now = toolkit::getCurrentMillisecond();
+    if (now > _lastRefillMs) {
+        _tokens = std::min<double>(_config.acceptBurst, _tokens + (now - _lastRefillMs) * _config.acceptRate / 1000);
+        _lastRefillMs = now;
+    }
+    if (_tokens < 1) {
+        return false;
+    }
+    _tokens -= 1;
+    return true;
+}
+
+bool AdmissionControl::isOverload() {
+    // 最闲的poller 也达到阈值才算过载, 读取的是各poller 发布的缓存负载, 无锁
+    bool overload{true};
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr& executor) {
+        if (executor->getCachedLoad() < _config.maxLoad) {
+            overload = false;
+        }
+    });
+    return overload;
+}
+
+} // namespace myNet
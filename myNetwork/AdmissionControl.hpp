@@ -0,0 +1,81 @@
+#ifndef AdmissionControl_hpp
+#define AdmissionControl_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace myNet {
+
+// 连接准入控制: 并发会话数上限, 令牌桶限速, 按poller 负载过载保护
+// 由TCPServer 及其克隆共享, accept 发生在多个poller 线程
+class AdmissionControl {
+  public:
+    using Ptr = std::shared_ptr<AdmissionControl>;
+
+    // 过载时的处理策略
+    enum class ShedPolicy {
+        RejectFast,  // 直接关闭新连接
+        PauseAccept, // 关闭新连接并暂停监听一段时间
+        EvictIdle,   // 会话数超限时淘汰最久空闲的会话以接纳新连接
+    };
+
+    // 拒绝原因
+    enum class Verdict { Accept = 0, MaxSessions, RateLimited, Overload };
+
+    struct Config {
+        size_t maxSessions{0};  // 最大并发会话数, 0 不限制
+        double acceptRate{0};   // 每秒最多接受的连接数(令牌桶), 0 不限制
+        size_t acceptBurst{0};  // 令牌桶容量, 0 时取acceptRate
+        int maxLoad{0};         // 所有poller 负载都不低于该值(0-100)时判定过载, 0 不启用
+        ShedPolicy policy{ShedPolicy::RejectFast};
+        uint32_t pauseMs{100};  // PauseAccept 暂停监听的时长
+        uint32_t minIdleMs{0};  // EvictIdle 只淘汰空闲超过该时长的会话
+    };
+
+    explicit AdmissionControl(const Config& config);
+    ~AdmissionControl() = default;
+
+    const Config& getConfig() const {
+        return _config;
+    }
+
+    // accept 之后、创建Session 之前调用
+    Verdict check();
+
+    void onSessionCreated() {
+        ++_sessions;
+    }
+    void onSessionClosed() {
+        --_sessions;
+    }
+    size_t getSessionCount() const {
+        return _sessions.load();
+    }
+
+    // 被拒绝的连接总数
+    uint64_t getRejectedCount() const {
+        return _rejected.load();
+    }
+    void onRejected() {
+        ++_rejected;
+    }
+
+  private:
+    bool takeToken();
+    bool isOverload();
+
+    Config _config;
+    std::atomic<size_t> _sessions{0};
+    std::atomic<uint64_t> _rejected{0};
+
+    // 令牌桶
+    std::mutex _mtxBucket;
+    double _tokens;
+    uint64_t _lastRefillMs;
+};
+
+} // namespace myNet
+
+#endif // AdmissionControl_hpp
@@ -1,32 +1,58 @@
 #include "Buffer.hpp"
 
 #include <assert.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
 
 #include "Network/Buffer.h"
+#include "SocketUtil.hpp"
 #include "Util/logger.h"
 #include "uv_errno.hpp"
 
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+// 连续收到多少次拷贝完成通知后回退为普通发送(如回环或网卡不支持分散聚集)
+#define ZERO_COPY_MAX_COPIED 16
+
 namespace myNet {
 
-BufferString::BufferString(std::string data, size_t offset, size_t len) : _data(std::move(data)) {
-    assert(offset + len <= _data.size());
-    if (!len) len = _data.size() - offset;
-    _size = len;
-    _offset = offset;
+BufferSlice::Ptr BufferSlice::create(Buffer::Ptr parent, size_t offset, size_t size) {
+    if (auto slice = dynamic_cast<BufferSlice*>(parent.get())) {
+        assert(offset + size <= slice->size());
+        offset += slice->_offset;
+        parent = slice->_parent;
+    }
+    return std::allocate_shared<BufferSlice>(BufferPoolAllocator<BufferSlice>(), std::move(parent), offset, size);
 }
 
 void BufferRaw::setCapacity(size_t capacity) {
     if (_data) {
-        if (capacity > _capacity) {
-            delete[] _data;
-        } else if (_capacity < 2 * 1024 || _capacity < 2 * capacity) { // 小于两字节或请求内存大于当前内存的一半，不用重新分配内存
+        if (capacity <= _capacity && (_capacity < 2 * 1024 || _capacity < 2 * capacity)) { // 小于两字节或请求内存大于当前内存的一半，不用重新分配内存
             return;
         }
+        BufferPool::deallocate(_data);
+        _data = nullptr;
     }
 
-    _data = new char[capacity];
-    _capacity = capacity;
+    // 实际容量为所在级别的大小, 之后小幅增长不必重新分配
+    _data = static_cast<char*>(BufferPool::allocate(capacity, _capacity));
 }
 
 void BufferRaw::setSize(size_t size) {
@@ -44,6 +70,120 @@ void BufferRaw::assign(const char* data, size_t size) {
     setSize(size);
 }
 
+BufferFile::File::~File() {
+    if (own) {
+        close(fd);
+    }
+}
+
+BufferFile::Ptr BufferFile::create(const std::string& path, off_t offset, size_t length) {
+    int fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+    if (-1 == fd) {
+        WarnL << "Open file " << path << " failed: " << uv_strerror(uv_translate_posix_error(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if (-1 == fstat(fd, &st) || offset > st.st_size) {
+        WarnL << "Invalid file " << path << " or offset " << offset;
+        close(fd);
+        return nullptr;
+    }
+    // 超出文件结尾的部分无法发送, 映射后访问会触发SIGBUS
+    if (!length || offset + (off_t)length > st.st_size) {
+        length = st.st_size - offset;
+    }
+    return std::make_shared<BufferFile>(fd, offset, length);
+}
+
+BufferFile::BufferFile(int fd, off_t offset, size_t length, bool ownFd) : _file(new File{fd, ownFd}), _offset(offset), _size(length) {}
+
+BufferFile::~BufferFile() {
+    if (_map) {
+        munmap(_map, _mapSize);
+    }
+}
+
+BufferFile::Ptr BufferFile::slice(off_t offset, size_t length) const {
+    return Ptr(new BufferFile(_file, offset, length));
+}
+
+char* BufferFile::data() const {
+    std::call_once(_mapFlag, [this]() { map(); });
+    return _data;
+}
+
+void BufferFile::map() const {
+    if (!_size) {
+        return;
+    }
+    // 映射起点需按页对齐, 私有映射写入不会修改文件
+    static const off_t pageSize = sysconf(_SC_PAGESIZE);
+    auto mapOffset = _offset - _offset % pageSize;
+    _mapSize = _size + (_offset - mapOffset);
+    auto addr = mmap(nullptr, _mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, _file->fd, mapOffset);
+    if (addr != MAP_FAILED) {
+        _map = (char*)addr;
+        _data = _map + (_offset - mapOffset);
+        return;
+    }
+
+    WarnL << "Mmap file failed, read it into memory: " << uv_strerror(uv_translate_posix_error(errno));
+    _copy.resize(_size);
+    size_t got = 0;
+    while (got < _size) {
+        auto n = pread(_file->fd, &_copy[got], _size - got, _offset + got);
+        if (n > 0) {
+            got += n;
+        } else if (-1 == n && UV_EINTR == uv_translate_posix_error(errno)) {
+            continue;
+        } else {
+            WarnL << "Read file failed: " << uv_strerror(uv_translate_posix_error(errno));
+            return;
+        }
+    }
+    _data = &_copy[0];
+}
+
+char* BufferSlabAllocator::prepare(size_t minSize, size_t& capacity) {
+    if (!_slab || _slab->getCapacity() < _offset + minSize + 1) {
+        if (_slab) {
+            _retired.emplace_back(std::move(_slab));
+        }
+        _slab = takeSlab(minSize + 1);
+        _offset = 0;
+    }
+    capacity = _slab->getCapacity() - _offset - 1;
+    return _slab->data() + _offset;
+}
+
+Buffer::Ptr BufferSlabAllocator::commit(size_t size) {
+    assert(_slab && _offset + size < _slab->getCapacity());
+    _slab->data()[_offset + size] = '\0';
+    auto ret = std::allocate_shared<BufferSlice>(BufferPoolAllocator<BufferSlice>(), _slab, _offset, size);
+    // 下一段按8 字节对齐
+    _offset = (_offset + size + 1 + 7) & ~(size_t)7;
+    return ret;
+}
+
+BufferRaw::Ptr BufferSlabAllocator::takeSlab(size_t minSize) {
+    for (auto it = _retired.begin(); it != _retired.end(); ++it) {
+        if (it->use_count() == 1 && (*it)->getCapacity() >= minSize) {
+            // 与其他线程释放引用时的写操作同步
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto ret = std::move(*it);
+            _retired.erase(it);
+            return ret;
+        }
+    }
+    // 缓存已满时放弃最早的slab, 其在最后一个引用释放时回收
+    while (_retired.size() >= _maxCached) {
+        _retired.pop_front();
+    }
+    auto ret = BufferRaw::create();
+    ret->setCapacity(std::max(_slabSize, minSize));
+    return ret;
+}
+
 #define INET4LEN 16U
 #define INET6LEN 28U
 
@@ -74,70 +214,488 @@ void BufferCallback::sendFrontSuccess() {
     _bufList.pop_front();
 }
 
-BufferSendMsg::BufferSendMsg(std::list<Buffer::Ptr> bufList, onSendResultCB sendResultCB) : BufferCallback(std::move(bufList), std::move(sendResultCB)), _iovec(_bufList.size()) {
-    size_t i = 0;
+uint32_t ZeroCopyTracker::onSend() {
+    std::lock_guard<std::mutex> lck(_mtx);
+    return _nextSeq++;
+}
+
+void ZeroCopyTracker::hold(uint32_t seq, Buffer::Ptr buf, const BufferList::onSendResultCB& sendResultCB) {
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        // 完成通知未到达
+        if ((int32_t)(seq - _completedSeq) >= 0) {
+            _pending.push_back(Pending{seq, std::move(buf), sendResultCB});
+            return;
+        }
+    }
+    if (sendResultCB) {
+        sendResultCB(buf, true);
+    }
+}
+
+void ZeroCopyTracker::onCompleted(uint32_t lo, uint32_t hi, bool copied, std::vector<Pending>& done) {
+    if ((int32_t)(lo - _completedSeq) <= 0 && (int32_t)(hi + 1 - _completedSeq) > 0) {
+        _completedSeq = hi + 1;
+    }
+    for (auto it = _pending.begin(); it != _pending.end();) {
+        if ((uint32_t)(it->seq - lo) <= (uint32_t)(hi - lo)) {
+            done.emplace_back(std::move(*it));
+            it = _pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (!copied) {
+        _copied = 0;
+    } else if (++_copied == ZERO_COPY_MAX_COPIED) {
+        _enabled = false;
+        InfoL << "Kernel copied zerocopy sends " << _copied << " times, fall back to normal send.";
+    }
+}
+
+void ZeroCopyTracker::onErrQueue(int fd) {
+    std::vector<Pending> done;
+    char control[128];
+    while (true) {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (-1 == recvmsg(fd, &msg, MSG_ERRQUEUE)) {
+            if (UV_EINTR == uv_translate_posix_error(errno)) continue;
+            break;
+        }
+
+        std::lock_guard<std::mutex> lck(_mtx);
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            auto err = (sock_extended_err*)CMSG_DATA(cmsg);
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0) {
+                continue;
+            }
+            // [ee_info, ee_data] 范围内的发送已完成
+            onCompleted(err->ee_info, err->ee_data, err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED, done);
+        }
+    }
+
+    for (auto& pending : done) {
+        if (pending.cb) {
+            pending.cb(pending.buf, true);
+        }
+    }
+}
+
+void ZeroCopyTracker::clear() {
+    std::deque<Pending> pending;
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        pending.swap(_pending);
+    }
+    for (auto& item : pending) {
+        if (item.cb) {
+            item.cb(item.buf, false);
+        }
+    }
+}
+
+// 合并小缓存使用的暂存缓存大小, 从内存池分配
+#define WRITE_COMBINE_STAGING_SIZE (16 * 1024)
+// 复用时保留的iovec 数组最大长度
+#define IOVEC_CACHE_MAX_SIZE IOV_MAX
+
+void IovecCache::take(std::vector<iovec>& vec) {
+    std::lock_guard<std::mutex> lck(_mtx);
+    vec.swap(_iovec);
+}
+
+void IovecCache::give(std::vector<iovec>& vec) {
+    if (vec.capacity() > IOVEC_CACHE_MAX_SIZE) {
+        return;
+    }
+    vec.clear();
+    std::lock_guard<std::mutex> lck(_mtx);
+    _iovec.swap(vec);
+}
+
+BufferSendMsg::BufferSendMsg(List bufList, onSendResultCB sendResultCB, const SendOption& option)
+    : BufferCallback(std::move(bufList), std::move(sendResultCB)), _zeroCopy(option.zeroCopy), _iovecCache(option.iovecCache) {
+    if (_iovecCache) {
+        _iovecCache->take(_iovec);
+    }
+    _iovec.resize(_bufList.size());
+
+    // 零拷贝发送时暂存缓存可能在完成通知前释放, 不合并
+    auto combineSize = _zeroCopy ? 0 : option.combineSize;
+    size_t n = 0;
+    // 上一项是否为小缓存, 以及是否已位于暂存缓存中
+    bool lastSmall = false, lastCombined = false;
     for (auto& buf : _bufList) {
-        _iovec[i].iov_base = buf->data();
-        _iovec[i].iov_len = buf->size();
-        _remainSize += _iovec[i].iov_len;
-        ++i;
+        auto size = buf->size();
+        _remainSize += size;
+        auto file = option.isUdp ? nullptr : dynamic_cast<BufferFile*>(buf.get());
+        bool small = !file && size < combineSize;
+        if (small && lastSmall && combine(n - 1, lastCombined, buf)) {
+            lastCombined = true;
+            continue;
+        }
+
+        if (file) {
+            // 不映射文件, 发送时由sendfile 按iov_len 计算已发送的偏移
+            if (_files.empty()) {
+                _files.resize(_iovec.size());
+            }
+            _files[n] = file;
+            _iovec[n].iov_base = nullptr;
+        } else {
+            _iovec[n].iov_base = buf->data();
+        }
+        _iovec[n].iov_len = size;
+        ++n;
+        lastSmall = small;
+        lastCombined = false;
+    }
+
+    _iovec.resize(n);
+    if (!_files.empty()) {
+        _files.resize(n);
+    }
+    if (!_counts.empty()) {
+        _counts.resize(n);
+    }
+    if (option.offset) {
+        reOffset(option.offset);
+    }
+}
+
+BufferSendMsg::~BufferSendMsg() {
+    if (_iovecCache) {
+        _iovecCache->give(_iovec);
     }
 }
 
+bool BufferSendMsg::combine(size_t index, bool lastCombined, const Buffer::Ptr& buf) {
+    auto& last = _iovec[index];
+    auto need = buf->size() + (lastCombined ? 0 : last.iov_len);
+    if (_staging.empty() || _staging.back()->getCapacity() - _staging.back()->size() < need) {
+        // 已合并的项必须位于同一块暂存缓存的末尾
+        if (lastCombined || need > WRITE_COMBINE_STAGING_SIZE) {
+            return false;
+        }
+        auto staging = BufferRaw::create();
+        staging->setCapacity(WRITE_COMBINE_STAGING_SIZE);
+        _staging.emplace_back(std::move(staging));
+    }
+
+    auto& staging = _staging.back();
+    auto end = staging->data() + staging->size();
+    if (!lastCombined) {
+        memcpy(end, last.iov_base, last.iov_len);
+        last.iov_base = end;
+        end += last.iov_len;
+    }
+    memcpy(end, buf->data(), buf->size());
+    last.iov_len += buf->size();
+    staging->setSize(staging->size() + need);
+
+    if (_counts.empty()) {
+        _counts.resize(_iovec.size(), 1);
+    }
+    ++_counts[index];
+    return true;
+}
+
 ssize_t BufferSendMsg::send(int fd, int flags) {
     auto beginRemainSize = _remainSize;
     ssize_t sendingSize = 0;
+    auto zeroCopy = _zeroCopy ? MSG_ZEROCOPY : 0;
     while (_remainSize && sendingSize != -1) {
-        do {
-            msghdr msg;
-            msg.msg_name = nullptr;
-            msg.msg_namelen = 0;
-            msg.msg_iov = &(_iovec[_iovecOffset]);
-            msg.msg_iovlen = std::min(count(), (size_t)IOV_MAX);
-            msg.msg_control = nullptr;
-            msg.msg_controllen = 0;
-            msg.msg_flags = flags;
-            sendingSize = sendmsg(fd, &msg, flags);
-        } while (-1 == sendingSize && UV_EINTR == uv_translate_posix_error(errno));
+        if (!_files.empty() && _files[_iovecOffset]) {
+            sendingSize = sendFile(fd, flags, zeroCopy);
+        } else {
+            sendingSize = sendIovec(fd, flags, zeroCopy);
+        }
 
         if (sendingSize >= (ssize_t)_remainSize) {
             _remainSize = 0;
-            sendCompleted(true);
+            while (!_bufList.empty()) {
+                onFrontSent();
+            }
             break;
         }
 
+        // 单次最多发送IOV_MAX 个iovec, 遇到文件时分段发送, 未发送完时继续发送, 直到socket 缓冲区写满(EAGAIN)
         if (sendingSize > 0) {
             reOffset(sendingSize);
-            break;
         }
     }
 
     return beginRemainSize - _remainSize > 0 ? beginRemainSize - _remainSize : -1;
 }
 
+ssize_t BufferSendMsg::sendIovec(int fd, int flags, int& zeroCopy) {
+    // 发送到下一个文件之前
+    auto iovCount = std::min(_iovec.size() - _iovecOffset, (size_t)IOV_MAX);
+    if (!_files.empty()) {
+        for (size_t i = 1; i < iovCount; ++i) {
+            if (_files[_iovecOffset + i]) {
+                iovCount = i;
+                break;
+            }
+        }
+    }
+
+    ssize_t sendingSize;
+    do {
+        msghdr msg;
+        msg.msg_name = nullptr;
+        msg.msg_namelen = 0;
+        msg.msg_iov = &(_iovec[_iovecOffset]);
+        msg.msg_iovlen = iovCount;
+        msg.msg_control = nullptr;
+        msg.msg_controllen = 0;
+        msg.msg_flags = flags;
+        ++_syscalls;
+        sendingSize = sendmsg(fd, &msg, flags | zeroCopy);
+        // 锁定内存超出限制, 本轮改为拷贝发送
+        if (-1 == sendingSize && zeroCopy && ENOBUFS == errno) {
+            zeroCopy = 0;
+            ++_syscalls;
+            sendingSize = sendmsg(fd, &msg, flags);
+        }
+    } while (-1 == sendingSize && UV_EINTR == uv_translate_posix_error(errno));
+
+    if (sendingSize > 0 && zeroCopy) {
+        _zeroCopySent = true;
+        _zeroCopySeq = _zeroCopy->onSend();
+    }
+    return sendingSize;
+}
+
+ssize_t BufferSendMsg::sendFile(int fd, int flags, int& zeroCopy) {
+    auto file = _files[_iovecOffset];
+    auto& iov = _iovec[_iovecOffset];
+    auto sent = file->size() - iov.iov_len;
+    off_t offset = file->getOffset() + sent;
+
+    ssize_t sendingSize;
+    do {
+        ++_syscalls;
+        sendingSize = sendfile(fd, file->getFd(), &offset, iov.iov_len);
+    } while (-1 == sendingSize && UV_EINTR == uv_translate_posix_error(errno));
+
+    if (0 == sendingSize) {
+        // 文件已被截断
+        errno = EIO;
+        return -1;
+    }
+    if (-1 == sendingSize && (EINVAL == errno || ENOSYS == errno)) {
+        // 该文件不支持sendfile, 改为映射后普通发送
+        if (!file->data()) {
+            errno = EIO;
+            return -1;
+        }
+        _files[_iovecOffset] = nullptr;
+        iov.iov_base = file->data() + sent;
+        return sendIovec(fd, flags, zeroCopy);
+    }
+    return sendingSize;
+}
+
+void BufferSendMsg::onFrontSent() {
+    // 内核可能仍在引用其内存, 需等待完成通知
+    if (_zeroCopySent) {
+        _zeroCopy->hold(_zeroCopySeq, std::move(_bufList.front()), _sendResultCB);
+        _bufList.pop_front();
+        return;
+    }
+    sendFrontSuccess();
+}
+
+void BufferSendMsg::onIovecSent() {
+    auto count = _counts.empty() ? 1 : _counts[_iovecOffset];
+    ++_iovecOffset;
+    while (count--) {
+        onFrontSent();
+    }
+}
+
 void BufferSendMsg::reOffset(size_t n) {
     _remainSize -= n;
-    size_t offset = 0;
-    for (auto i = _iovecOffset; i <= _iovec.size(); ++i) {
-        offset += _iovec[i].iov_len;
-        if (offset < n) {
-            sendFrontSuccess();
+    // 从当前项向后推进, 部分发送不会从头扫描
+    while (n) {
+        auto& iov = _iovec[_iovecOffset];
+        if (n < iov.iov_len) {
+            // 文件项只记录剩余长度
+            if (iov.iov_base) {
+                iov.iov_base = (char*)iov.iov_base + n;
+            }
+            iov.iov_len -= n;
+            return;
+        }
+        n -= iov.iov_len;
+        onIovecSent();
+    }
+}
+
+// 单个gso 消息最多包含的数据报个数与字节数
+#define UDP_GSO_MAX_SEGMENTS 64
+#define UDP_GSO_MAX_BYTES 65507
+
+static bool sameAddr(const msghdr& a, const msghdr& b) {
+    return a.msg_namelen == b.msg_namelen && (!a.msg_namelen || 0 == memcmp(a.msg_name, b.msg_name, a.msg_namelen));
+}
+
+BufferSendMMsg::BufferSendMMsg(List bufList, onSendResultCB sendResultCB, bool gso) : BufferCallback(std::move(bufList), std::move(sendResultCB)), _iovec(_bufList.size()) {
+    _hdrvec.reserve(_bufList.size());
+    size_t i = 0;
+    for (auto& buf : _bufList) {
+        _iovec[i].iov_base = buf->data();
+        _iovec[i].iov_len = buf->size();
+        _remainSize += _iovec[i].iov_len;
+
+        mmsghdr hdr;
+        auto& msg = hdr.msg_hdr;
+        memset(&msg, 0, sizeof(msg));
+        auto sockBuf = dynamic_cast<BufferSock*>(buf.get());
+        if (sockBuf && sockBuf->sockLen()) {
+            msg.msg_name = (void*)sockBuf->sockAddr();
+            msg.msg_namelen = sockBuf->sockLen();
+        }
+        msg.msg_iov = &_iovec[i];
+        msg.msg_iovlen = 1;
+        hdr.msg_len = 0;
+
+        // 与上一个消息合并: 地址相同, 长度与其首个数据报相同(或更短, 更短时该消息结束)
+        if (gso && !_hdrvec.empty()) {
+            auto& last = _hdrvec.back().msg_hdr;
+            auto& segments = _segments.back();
+            auto segmentSize = last.msg_iov[0].iov_len;
+            auto lastSize = last.msg_iov[last.msg_iovlen - 1].iov_len;
+            if (lastSize == segmentSize && _iovec[i].iov_len && _iovec[i].iov_len <= segmentSize && segments < UDP_GSO_MAX_SEGMENTS && (segments + 1) * segmentSize <= UDP_GSO_MAX_BYTES && sameAddr(last, msg)) {
+                ++last.msg_iovlen;
+                ++segments;
+                ++i;
+                continue;
+            }
+        }
+        _hdrvec.emplace_back(hdr);
+        if (gso) {
+            _segments.emplace_back(1);
+        }
+        ++i;
+    }
+
+    if (!gso) {
+        return;
+    }
+    // 多于一个数据报的消息附加UDP_SEGMENT 控制信息
+    auto space = CMSG_SPACE(sizeof(uint16_t));
+    _control.resize(space * _hdrvec.size());
+    for (size_t k = 0; k < _hdrvec.size(); ++k) {
+        auto& msg = _hdrvec[k].msg_hdr;
+        if (_segments[k] < 2) {
             continue;
         }
+        msg.msg_control = &_control[k * space];
+        msg.msg_controllen = space;
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        *(uint16_t*)CMSG_DATA(cmsg) = msg.msg_iov[0].iov_len;
+    }
+}
 
-        _iovecOffset = i;
-        if (offset - n == 0) {
-            _iovecOffset += 1;
-            sendFrontSuccess();
+void BufferSendMMsg::sendFrontFailed() {
+    if (_sendResultCB) {
+        _sendResultCB(_bufList.front(), false);
+    }
+    _bufList.pop_front();
+}
+
+ssize_t BufferSendMMsg::send(int fd, int flags) {
+    auto beginRemainSize = _remainSize;
+    while (_hdrvecOffset < _hdrvec.size()) {
+        int sent;
+        do {
+            ++_syscalls;
+            sent = sendmmsg(fd, &_hdrvec[_hdrvecOffset], std::min(count(), (size_t)UIO_MAXIOV), flags);
+        } while (-1 == sent && UV_EINTR == uv_translate_posix_error(errno));
+
+        if (-1 == sent) {
+            if (UV_EAGAIN == uv_translate_posix_error(errno)) {
+                break;
+            }
+            // 无法分段发送(如数据报超过MTU 或网卡不支持), 改为逐个发送
+            if (frontSegments() > 1) {
+                if (-1 == sendSeparately(fd, flags)) {
+                    break;
+                }
+                continue;
+            }
+            // 批量中的首个数据报发送失败, 只丢弃该数据报, 继续发送后续数据报
+            WarnL << "Send udp socket[" << fd << "] failed, datagram ignored: " << uv_strerror(uv_translate_posix_error(errno));
+            _remainSize -= _iovec[_iovecOffset++].iov_len;
+            ++_hdrvecOffset;
+            sendFrontFailed();
+            continue;
+        }
+
+        // 部分成功时, 之后的消息下次继续发送(出错的消息会在下次调用时返回错误)
+        for (int i = 0; i < sent; ++i) {
+            for (auto n = frontSegments(); n; --n) {
+                _remainSize -= _iovec[_iovecOffset++].iov_len;
+                sendFrontSuccess();
+            }
+            ++_hdrvecOffset;
+        }
+    }
+
+    return beginRemainSize - _remainSize > 0 ? beginRemainSize - _remainSize : -1;
+}
+
+ssize_t BufferSendMMsg::sendSeparately(int fd, int flags) {
+    auto& msg = _hdrvec[_hdrvecOffset].msg_hdr;
+    auto& segments = _segments[_hdrvecOffset];
+    while (segments) {
+        msghdr single = msg;
+        single.msg_iovlen = 1;
+        single.msg_control = nullptr;
+        single.msg_controllen = 0;
+        ssize_t n;
+        do {
+            ++_syscalls;
+            n = sendmsg(fd, &single, flags);
+        } while (-1 == n && UV_EINTR == uv_translate_posix_error(errno));
+
+        if (-1 == n && UV_EAGAIN == uv_translate_posix_error(errno)) {
+            return -1;
+        }
+        if (-1 == n) {
+            WarnL << "Send udp socket[" << fd << "] failed, datagram ignored: " << uv_strerror(uv_translate_posix_error(errno));
+        }
+        // 剩余的数据报留在该消息中, 下次继续
+        _remainSize -= _iovec[_iovecOffset++].iov_len;
+        ++msg.msg_iov;
+        --msg.msg_iovlen;
+        --segments;
+        if (-1 == n) {
+            sendFrontFailed();
         } else {
-            _iovec[i].iov_base = (char*)_iovec[i].iov_base + _iovec[i].iov_len - (offset - n);
-            _iovec[i].iov_len = offset - n;
+            sendFrontSuccess();
         }
-        break;
     }
+    ++_hdrvecOffset;
+    return 0;
 }
 
-BufferList::Ptr BufferList::create(std::list<Buffer::Ptr> bufList, onSendResultCB sendResultCB, bool isUdp) {
-    return std::make_shared<BufferSendMsg>(std::move(bufList), std::move(sendResultCB));
+BufferList::Ptr BufferList::create(List bufList, onSendResultCB sendResultCB, const SendOption& option) {
+    if (option.isUdp) {
+        return std::make_shared<BufferSendMMsg>(std::move(bufList), std::move(sendResultCB), option.udpGso);
+    }
+    return std::make_shared<BufferSendMsg>(std::move(bufList), std::move(sendResultCB), option);
 }
 } // namespace myNet
\ No newline at end of file
@@ -1,14 +1,19 @@
 #ifndef Buffer_hpp
 #define Buffer_hpp
 
+#include <assert.h>
 #include <sys/socket.h>
 
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "BufferPool.hpp"
 #include "myUtil.hpp"
 
 namespace myNet {
@@ -31,12 +36,19 @@ class Buffer : public noncopyable {
     }
 };
 
-class BufferString : public Buffer {
+// 接管容器(std::string, std::vector<char>) 中的数据, 右值传入时不拷贝
+template <typename C> class BufferOffset : public Buffer {
   public:
-    using Ptr = std::shared_ptr<BufferString>;
-
-    BufferString(std::string data, size_t offset = 0, size_t len = 0);
-    ~BufferString() override = default;
+    using Ptr = std::shared_ptr<BufferOffset>;
+
+    // len 为0 时到容器结尾
+    BufferOffset(C data, size_t offset = 0, size_t len = 0) : _data(std::move(data)) {
+        assert(offset + len <= _data.size());
+        if (!len) len = _data.size() - offset;
+        _size = len;
+        _offset = offset;
+    }
+    ~BufferOffset() override = default;
 
     char* data() const override {
         return const_cast<char*>(_data.data()) + _offset;
@@ -46,23 +58,25 @@ class BufferString : public Buffer {
     }
 
   private:
-    std::string _data;
+    C _data;
     size_t _size;
     size_t _offset;
 };
 
+using BufferString = BufferOffset<std::string>;
+using BufferVector = BufferOffset<std::vector<char>>;
+
 class BufferRaw : public Buffer {
   public:
     using Ptr = std::shared_ptr<BufferRaw>;
 
+    // 对象和数据都从内存池分配
     static Ptr create() {
-        return std::make_shared<BufferRaw>();
+        return std::allocate_shared<BufferRaw>(BufferPoolAllocator<BufferRaw>());
     };
 
     ~BufferRaw() override {
-        if (_data) {
-            delete[] _data;
-        }
+        BufferPool::deallocate(_data);
     }
 
     char* data() const override {
@@ -87,10 +101,117 @@ class BufferRaw : public Buffer {
     size_t _capacity{0};
 };
 
+// 另一个Buffer 中的一段数据, 持有其引用, 可直接保存或转发, 无需拷贝
+class BufferSlice : public Buffer {
+  public:
+    using Ptr = std::shared_ptr<BufferSlice>;
+
+    // 对象从内存池分配; parent 本身是切片时直接引用其上级, 避免多层嵌套
+    static Ptr create(Buffer::Ptr parent, size_t offset, size_t size);
+
+    BufferSlice(Buffer::Ptr parent, size_t offset, size_t size) : _parent(std::move(parent)), _offset(offset), _size(size) {
+        assert(offset + size <= _parent->getCapacity());
+    }
+    ~BufferSlice() override = default;
+
+    char* data() const override {
+        return _parent->data() + _offset;
+    }
+    size_t size() const override {
+        return _size;
+    }
+
+    const Buffer::Ptr& getParent() const {
+        return _parent;
+    }
+
+  private:
+    Buffer::Ptr _parent;
+    size_t _offset;
+    size_t _size;
+};
+
+// 文件中的一段数据, tcp 发送时由sendfile 直接从页缓存发送, 不读入用户内存
+// data() 首次调用时才mmap 映射(如udp 发送), 映射失败时读入内存
+class BufferFile : public Buffer {
+  public:
+    using Ptr = std::shared_ptr<BufferFile>;
+
+    // 打开文件, length 为0 时到文件结尾, 失败返回nullptr
+    static Ptr create(const std::string& path, off_t offset = 0, size_t length = 0);
+
+    // ownFd 为true 时由对象负责关闭fd
+    BufferFile(int fd, off_t offset, size_t length, bool ownFd = true);
+    ~BufferFile() override;
+
+    char* data() const override;
+    size_t size() const override {
+        return _size;
+    }
+
+    int getFd() const {
+        return _file->fd;
+    }
+    off_t getOffset() const {
+        return _offset;
+    }
+
+    // 同一文件中的另一段, 共享fd
+    Ptr slice(off_t offset, size_t length) const;
+
+  private:
+    struct File {
+        int fd;
+        bool own;
+        ~File();
+    };
+
+    BufferFile(std::shared_ptr<File> file, off_t offset, size_t length) : _file(std::move(file)), _offset(offset), _size(length) {}
+    void map() const;
+
+    std::shared_ptr<File> _file;
+    off_t _offset;
+    size_t _size;
+    mutable std::once_flag _mapFlag;
+    mutable char* _map{nullptr};
+    mutable size_t _mapSize{0};
+    mutable char* _data{nullptr};
+    // 映射失败时读入的数据
+    mutable std::string _copy;
+};
+
+// 接收slab 分配器, 每个poller 一个, 只能在poller 线程使用
+// 数据直接读入slab, 再按实际长度切出BufferSlice, slab 的最后一个引用释放后可再次使用
+class BufferSlabAllocator : public noncopyable {
+  public:
+    BufferSlabAllocator(size_t slabSize = 256 * 1024, size_t maxCached = 8) : _slabSize(slabSize), _maxCached(maxCached) {}
+    ~BufferSlabAllocator() = default;
+
+    // 获取至少minSize 字节的可写区域, capacity 返回可写长度(已预留结尾的'\0')
+    char* prepare(size_t minSize, size_t& capacity);
+
+    // 将prepare 得到的区域前size 字节切出为一个Buffer
+    Buffer::Ptr commit(size_t size);
+
+  private:
+    BufferRaw::Ptr takeSlab(size_t minSize);
+
+    size_t _slabSize;
+    size_t _maxCached;
+    size_t _offset{0};
+    BufferRaw::Ptr _slab;
+    // 已用完的slab, 引用计数为1 时说明已无人使用, 可再次使用
+    std::list<BufferRaw::Ptr> _retired;
+};
+
 #if !defined(IOV_MAX)
 #define IOV_MAX 1024
 #endif
 
+#if !defined(UIO_MAXIOV)
+#define UIO_MAXIOV 1024
+#endif
+
 class BufferSock : public Buffer {
   public:
     using Ptr = std::shared_ptr<BufferSock>;
@@ -117,25 +238,59 @@ class BufferSock : public Buffer {
     Buffer::Ptr _buffer;
 };
 
+class ZeroCopyTracker;
+class IovecCache;
+
 class BufferList : public noncopyable {
   public:
     using Ptr = std::shared_ptr<BufferList>;
     using onSendResultCB = std::function<void(const Buffer::Ptr& Buffer, bool sendSuccess)>;
+    // 链表节点也从内存池分配, 发送时每条消息不再单独申请内存
+    using List = std::list<Buffer::Ptr, BufferPoolAllocator<Buffer::Ptr>>;
+
+    struct SendOption {
+        bool isUdp{false};
+        // 合并连续发往同一地址的等长udp 数据报(UDP_SEGMENT)
+        bool udpGso{false};
+        // 小于该长度的相邻缓存拷贝到暂存缓存中合并为一项发送, 0 表示不合并(仅tcp)
+        size_t combineSize{0};
+        // 非空时使用MSG_ZEROCOPY 发送(仅tcp)
+        std::shared_ptr<ZeroCopyTracker> zeroCopy;
+        // 非空时复用其中的iovec 数组(仅tcp)
+        std::shared_ptr<IovecCache> iovecCache;
+        // 第一个缓存已发送的字节数, 从该偏移开始发送, 回调的仍是原缓存(仅tcp)
+        size_t offset{0};
+    };
 
-    // 原代码有针对udp大量数据的优化，暂时未实现
-    static Ptr create(std::list<Buffer::Ptr> bufList, onSendResultCB sendResultCB, bool isUdp);
+    // udp 使用sendmmsg 批量发送, 每个数据报可通过BufferSock 指定目标地址
+    static Ptr create(List bufList, onSendResultCB sendResultCB, const SendOption& option);
+    static Ptr create(List bufList, onSendResultCB sendResultCB, bool isUdp) {
+        SendOption option;
+        option.isUdp = isUdp;
+        return create(std::move(bufList), std::move(sendResultCB), option);
+    }
 
     BufferList() = default;
     virtual ~BufferList() = default;
 
     virtual bool empty() = 0;
     virtual size_t count() = 0;
+    // 未发送的字节数
+    virtual size_t remainSize() = 0;
     virtual ssize_t send(int fd, int flags) = 0;
+
+    // 累计调用发送系统调用的次数
+    size_t syscalls() const {
+        return _syscalls;
+    }
+
+  protected:
+    size_t _syscalls{0};
 };
 
 class BufferCallback {
   public:
-    BufferCallback(std::list<Buffer::Ptr> bufList, BufferList::onSendResultCB sendResultCB) : _bufList(std::move(bufList)), _sendResultCB(std::move(sendResultCB)){};
+    BufferCallback(BufferList::List bufList, BufferList::onSendResultCB sendResultCB) : _bufList(std::move(bufList)), _sendResultCB(std::move(sendResultCB)){};
 
     ~BufferCallback() {
         sendCompleted(false);
@@ -147,28 +302,151 @@ class BufferCallback {
 
   protected:
     BufferList::onSendResultCB _sendResultCB;
-    std::list<Buffer::Ptr> _bufList;
+    BufferList::List _bufList;
+};
+
+// 跟踪MSG_ZEROCOPY 发送的缓存, 内核完成通知到达前保持引用, 之后才回调发送结果
+// 每个fd 一个, 序号与内核为该fd 分配的完成序号一致
+class ZeroCopyTracker : public noncopyable {
+  public:
+    using Ptr = std::shared_ptr<ZeroCopyTracker>;
+
+    explicit ZeroCopyTracker(size_t threshold) : _threshold(threshold) {}
+    ~ZeroCopyTracker() {
+        clear();
+    }
+
+    // 待发送数据达到阈值且未回退为拷贝发送时使用MSG_ZEROCOPY
+    bool accept(size_t bytes) const {
+        return _enabled && bytes >= _threshold;
+    }
+
+    // 一次sendmsg(MSG_ZEROCOPY) 成功, 返回其完成序号
+    uint32_t onSend();
+
+    // buf 已全部交给内核, 序号seq 完成后回调
+    void hold(uint32_t seq, Buffer::Ptr buf, const BufferList::onSendResultCB& sendResultCB);
+
+    // 读取MSG_ERRQUEUE 中的完成通知, 释放已完成的缓存
+    void onErrQueue(int fd);
+
+    // 释放所有缓存并回调失败, fd 关闭时调用
+    void clear();
+
+  private:
+    struct Pending {
+        uint32_t seq;
+        Buffer::Ptr buf;
+        BufferList::onSendResultCB cb;
+    };
+
+    void onCompleted(uint32_t lo, uint32_t hi, bool copied, std::vector<Pending>& done);
+
+    size_t _threshold;
+    std::atomic<bool> _enabled{true};
+    // 连续收到的拷贝完成通知数
+    size_t _copied{0};
+    std::mutex _mtx;
+    uint32_t _nextSeq{0};
+    // 小于该序号的发送均已完成(TCP 按序完成)
+    uint32_t _completedSeq{0};
+    std::deque<Pending> _pending;
+};
+
+// 复用BufferSendMsg 的iovec 数组, 每个socket 一个, 避免每次flush 重新分配
+class IovecCache : public noncopyable {
+  public:
+    using Ptr = std::shared_ptr<IovecCache>;
+
+    void take(std::vector<iovec>& vec);
+    // 过大的数组不保留
+    void give(std::vector<iovec>& vec);
+
+  private:
+    std::mutex _mtx;
+    std::vector<iovec> _iovec;
 };
 
 class BufferSendMsg : public BufferList, public BufferCallback {
   public:
-    BufferSendMsg(std::list<Buffer::Ptr> bufList, onSendResultCB sendResultCB);
-    ~BufferSendMsg() override = default;
+    // tcp 发送时BufferFile 使用sendfile, 与其他缓存按顺序交替发送
+    BufferSendMsg(List bufList, onSendResultCB sendResultCB, const SendOption& option = SendOption());
+    ~BufferSendMsg() override;
 
     bool empty() override {
         return _remainSize == 0;
     }
     size_t count() override {
-        return _iovec.size() - _iovecOffset;
+        return _bufList.size();
+    }
+    size_t remainSize() override {
+        return _remainSize;
     }
     ssize_t send(int fd, int flags) override;
 
   private:
+    // 将小缓存拷贝到暂存缓存, 与上一项合并, 暂存缓存空间不足时返回false
+    bool combine(size_t index, bool lastCombined, const Buffer::Ptr& buf);
+    ssize_t sendIovec(int fd, int flags, int& zeroCopy);
+    ssize_t sendFile(int fd, int flags, int& zeroCopy);
     void reOffset(size_t n);
+    // 首项已全部发送, 回调其包含的所有缓存
+    void onIovecSent();
+    // 首个缓存已全部发送, 零拷贝模式下交给tracker 等待完成通知
+    void onFrontSent();
+
+    // 非空时使用MSG_ZEROCOPY 发送
+    ZeroCopyTracker::Ptr _zeroCopy;
+    bool _zeroCopySent{false};
+    uint32_t _zeroCopySeq{0};
+    size_t _iovecOffset{0};
+    size_t _remainSize{0};
+    IovecCache::Ptr _iovecCache;
+    std::vector<iovec> _iovec;
+    // 与_iovec 一一对应, 非空表示该项使用sendfile 发送, 不含文件时为空
+    std::vector<BufferFile*> _files;
+    // 与_iovec 一一对应, 每项包含的缓存个数, 没有合并时为空
+    std::vector<uint32_t> _counts;
+    // 合并小缓存使用的暂存缓存
+    std::vector<BufferRaw::Ptr> _staging;
+};
+
+// udp 批量发送, 每个缓存为一个数据报, 单次sendmmsg 最多UIO_MAXIOV 个消息
+// 开启gso 时, 连续发往同一地址的等长数据报(最后一个可以更短)合并为一个消息, 由内核(或网卡)分段
+class BufferSendMMsg : public BufferList, public BufferCallback {
+  public:
+    BufferSendMMsg(List bufList, onSendResultCB sendResultCB, bool gso = false);
+    ~BufferSendMMsg() override = default;
+
+    bool empty() override {
+        return _remainSize == 0;
+    }
+    size_t count() override {
+        return _hdrvec.size() - _hdrvecOffset;
+    }
+    size_t remainSize() override {
+        return _remainSize;
+    }
+    ssize_t send(int fd, int flags) override;
+
+  private:
+    // 丢弃首个数据报并回调失败
+    void sendFrontFailed();
+    // 首个消息的数据报个数
+    size_t frontSegments() const {
+        return _segments.empty() ? 1 : _segments[_hdrvecOffset];
+    }
+    // 首个消息无法分段发送时逐个发送其中的数据报
+    ssize_t sendSeparately(int fd, int flags);
 
+    size_t _hdrvecOffset{0};
     size_t _iovecOffset{0};
     size_t _remainSize{0};
     std::vector<iovec> _iovec;
+    std::vector<mmsghdr> _hdrvec;
+    // 开启gso 时每个消息包含的数据报个数及其UDP_SEGMENT 控制信息
+    std::vector<uint16_t> _segments;
+    std::vector<char> _control;
 };
 
 } // namespace myNet
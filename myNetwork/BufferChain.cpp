@@ -0,0 +1,172 @@
+#include "BufferChain.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace myNet {
+
+void BufferChain::append(Buffer::Ptr buf) {
+    if (!buf || !buf->size()) {
+        return;
+    }
+    _size += buf->size();
+    _bufs.emplace_back(std::move(buf));
+}
+
+void BufferChain::append(const char* data, size_t size) {
+    if (!size) {
+        return;
+    }
+    auto buf = BufferRaw::create();
+    buf->assign(data, size);
+    append(std::move(buf));
+}
+
+void BufferChain::clear() {
+    _bufs.clear();
+    _size = 0;
+    _offset = 0;
+}
+
+size_t BufferChain::peek(char* dst, size_t len) const {
+    len = std::min(len, _size);
+    size_t copied = 0, offset = _offset;
+    for (auto it = _bufs.begin(); it != _bufs.end() && copied < len; ++it) {
+        auto n = std::min((*it)->size() - offset, len - copied);
+        memcpy(dst + copied, (*it)->data() + offset, n);
+        copied += n;
+        offset = 0;
+    }
+    return copied;
+}
+
+void BufferChain::consume(size_t len) {
+    len = std::min(len, _size);
+    _size -= len;
+    while (len) {
+        auto remain = _bufs.front()->size() - _offset;
+        if (len < remain) {
+            _offset += len;
+            return;
+        }
+        len -= remain;
+        _offset = 0;
+        _bufs.pop_front();
+    }
+}
+
+bool BufferChain::locate(size_t pos, size_t& index, size_t& offset) const {
+    if (pos >= _size) {
+        return false;
+    }
+    pos += _offset;
+    for (index = 0; index < _bufs.size(); ++index) {
+        auto size = _bufs[index]->size();
+        if (pos < size) {
+            offset = pos;
+            return true;
+        }
+        pos -= size;
+    }
+    return false;
+}
+
+bool BufferChain::match(size_t index, size_t offset, const char* delim, size_t delimLen) const {
+    for (size_t i = 0; i < delimLen; ++i) {
+        if (offset == _bufs[index]->size()) {
+            if (++index == _bufs.size()) {
+                return false;
+            }
+            offset = 0;
+        }
+        if (_bufs[index]->data()[offset++] != delim[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t BufferChain::find(const char* delim, size_t delimLen, size_t start) const {
+    size_t index, offset;
+    if (!delimLen || start + delimLen > _size || !locate(start, index, offset)) {
+        return npos;
+    }
+
+    // 逐段用memchr 查找首字节, 再比较剩余部分(可能跨段)
+    size_t pos = start;
+    for (; index < _bufs.size(); ++index, offset = 0) {
+        auto data = _bufs[index]->data();
+        auto size = _bufs[index]->size();
+        while (offset < size) {
+            auto hit = static_cast<const char*>(memchr(data + offset, delim[0], size - offset));
+            if (!hit) {
+                pos += size - offset;
+                break;
+            }
+            auto skip = hit - (data + offset);
+            pos += skip;
+            offset += skip;
+            if (pos + delimLen > _size) {
+                return npos;
+            }
+            if (match(index, offset, delim, delimLen)) {
+                return pos;
+            }
+            ++pos;
+            ++offset;
+        }
+    }
+    return npos;
+}
+
+Buffer::Ptr BufferChain::contiguous(size_t len) {
+    len = std::min(len, _size);
+    if (!len) {
+        return nullptr;
+    }
+
+    auto& front = _bufs.front();
+    if (front->size() - _offset >= len) {
+        if (_offset == 0 && front->size() == len) {
+            return front;
+        }
+        return BufferSlice::create(front, _offset, len);
+    }
+
+    // 跨越多段, 合并到一块新的内存中, 之后再次访问不会重复拷贝
+    auto merged = BufferRaw::create();
+    merged->setCapacity(len + 1);
+    peek(merged->data(), len);
+    merged->data()[len] = '\0';
+    merged->setSize(len);
+
+    size_t removed = 0;
+    while (removed < len) {
+        auto remain = _bufs.front()->size() - _offset;
+        if (removed + remain > len) {
+            // 最后一段只用了一部分, 保留剩余部分的引用
+            auto used = len - removed;
+            auto rest = BufferSlice::create(_bufs.front(), _offset + used, remain - used);
+            _bufs.front() = std::move(rest);
+            _offset = 0;
+            break;
+        }
+        removed += remain;
+        _offset = 0;
+        _bufs.pop_front();
+    }
+    _bufs.emplace_front(merged);
+    return merged;
+}
+
+Buffer::Ptr BufferChain::read(size_t len) {
+    auto ret = contiguous(len);
+    if (ret) {
+        consume(ret->size());
+    }
+    return ret;
+}
+
+} // namespace myNet
@@ -0,0 +1,66 @@
+#ifndef BufferChain_hpp
+#define BufferChain_hpp
+
+#include <deque>
+#include <string>
+
+#include "Buffer.hpp"
+
+namespace myNet {
+
+// 由多个Buffer 引用组成的链式缓存, 用于流式会话拼包
+// 追加时只保存引用, 数据只在需要连续内存且跨越多段时拷贝一次
+class BufferChain : public noncopyable {
+  public:
+    using Ptr = std::shared_ptr<BufferChain>;
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    BufferChain() = default;
+    ~BufferChain() = default;
+
+    // 追加数据, 只保存引用, buf 的内容之后不能再被修改(如poller 共享的读缓存)
+    void append(Buffer::Ptr buf);
+
+    // 拷贝追加
+    void append(const char* data, size_t size);
+
+    size_t size() const {
+        return _size;
+    }
+    bool empty() const {
+        return _size == 0;
+    }
+    void clear();
+
+    // 拷贝前len 字节到dst, 不移除数据, 返回实际拷贝的长度
+    size_t peek(char* dst, size_t len) const;
+
+    // 移除前len 字节
+    void consume(size_t len);
+
+    // 从start 开始查找分隔符, 返回相对读位置的偏移, 未找到返回npos
+    size_t find(const char* delim, size_t delimLen, size_t start) const;
+    size_t find(const std::string& delim, size_t start = 0) const {
+        return find(delim.data(), delim.size(), start);
+    }
+
+    // 获取前len 字节的连续内存, 位于同一段时不拷贝, 跨越多段时合并为一段
+    Buffer::Ptr contiguous(size_t len);
+
+    // 取出前len 字节
+    Buffer::Ptr read(size_t len);
+
+  private:
+    // 定位第pos 个字节所在的段及段内偏移
+    bool locate(size_t pos, size_t& index, size_t& offset) const;
+    bool match(size_t index, size_t offset, const char* delim, size_t delimLen) const;
+
+    size_t _size{0};
+    // 首段已消费的字节数
+    size_t _offset{0};
+    std::deque<Buffer::Ptr> _bufs;
+};
+
+} // namespace myNet
+
+#endif // BufferChain_hpp
@@ -0,0 +1,230 @@
+#include "BufferPool.hpp"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+// 最小级别64B, 最大级别64KB
+#define MIN_CLASS_SHIFT 6
+#define MAX_CLASS_SHIFT 16
+#define CLASS_COUNT (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1)
+// 每一级空闲链表最多缓存的字节数
+#define MAX_CACHE_BYTES_PER_CLASS (512 * 1024)
+// 不属于任何级别, 直接free
+#define NO_CLASS 0xFF
+
+namespace myNet {
+
+namespace {
+
+class ThreadCache;
+
+// 每个内存块前的头部, 保证用户数据16字节对齐
+struct alignas(16) BlockHeader {
+    ThreadCache* owner;
+    BlockHeader* next;
+    uint8_t sizeClass;
+};
+
+inline size_t classSize(uint8_t sizeClass) {
+    return size_t(1) << (sizeClass + MIN_CLASS_SHIFT);
+}
+
+inline uint8_t sizeToClass(size_t size) {
+    uint8_t sizeClass = 0;
+    while (classSize(sizeClass) < size) ++sizeClass;
+    return sizeClass;
+}
+
+inline void* toUser(BlockHeader* header) {
+    return header + 1;
+}
+
+inline BlockHeader* toHeader(void* ptr) {
+    return static_cast<BlockHeader*>(ptr) - 1;
+}
+
+// 线程缓存, 引用计数为其名下的内存块数量 + 1(线程自身)
+// 线程退出后仍可能有内存块在其他线程中, 最后一个内存块释放时删除
+class ThreadCache {
+  public:
+    void* allocate(uint8_t sizeClass) {
+        auto& list = _freeList[sizeClass];
+        if (!list.head && _remoteFree.load(std::memory_order_relaxed)) {
+            collectRemote();
+        }
+        if (list.head) {
+            auto header = list.head;
+            list.head = header->next;
+            --list.count;
+            return toUser(header);
+        }
+
+        auto header = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + classSize(sizeClass)));
+        if (!header) {
+            throw std::bad_alloc();
+        }
+        header->owner = this;
+        header->sizeClass = sizeClass;
+        _ref.fetch_add(1, std::memory_order_relaxed);
+        return toUser(header);
+    }
+
+    // 所属线程释放
+    void deallocateLocal(BlockHeader* header) {
+        auto& list = _freeList[header->sizeClass];
+        if (list.count * classSize(header->sizeClass) >= MAX_CACHE_BYTES_PER_CLASS) {
+            free(header);
+            release();
+            return;
+        }
+        header->next = list.head;
+        list.head = header;
+        ++list.count;
+    }
+
+    // 其他线程释放, 无锁入栈
+    void deallocateRemote(BlockHeader* header) {
+        // 持有临时引用, 防止入栈期间缓存被其他线程删除
+        _ref.fetch_add(1, std::memory_order_relaxed);
+        auto head = _remoteFree.load(std::memory_order_relaxed);
+        do {
+            header->next = head;
+        } while (!_remoteFree.compare_exchange_weak(head, header));
+
+        // 所属线程已退出, 不会再回收, 由释放方自行清理
+        // 入栈与退出标记均为顺序一致, 释放方与所属线程至少有一方能看到该内存块
+        if (!_alive.load()) {
+            freeRemote();
+        }
+        release();
+    }
+
+    // 线程退出
+    void exit() {
+        for (auto& list : _freeList) {
+            while (list.head) {
+                auto header = list.head;
+                list.head = header->next;
+                free(header);
+                release();
+            }
+            list.count = 0;
+        }
+        _alive.store(false);
+        freeRemote();
+        release();
+    }
+
+  private:
+    struct FreeList {
+        BlockHeader* head{nullptr};
+        size_t count{0};
+    };
+
+    void collectRemote() {
+        // 单消费者整体取走, 不存在ABA 问题
+        auto header = _remoteFree.exchange(nullptr, std::memory_order_acquire);
+        while (header) {
+            auto next = header->next;
+            deallocateLocal(header);
+            header = next;
+        }
+    }
+
+    void freeRemote() {
+        auto header = _remoteFree.exchange(nullptr);
+        while (header) {
+            auto next = header->next;
+            free(header);
+            release();
+            header = next;
+        }
+    }
+
+    void release() {
+        if (_ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    FreeList _freeList[CLASS_COUNT];
+    std::atomic<size_t> _ref{1};
+    std::atomic<bool> _alive{true};
+    alignas(64) std::atomic<BlockHeader*> _remoteFree{nullptr};
+};
+
+// 线程退出时释放线程缓存
+struct ThreadCacheHolder {
+    ThreadCache* cache{nullptr};
+    ~ThreadCacheHolder();
+};
+
+thread_local ThreadCacheHolder s_holder;
+thread_local ThreadCache* s_cache = nullptr;
+
+ThreadCacheHolder::~ThreadCacheHolder() {
+    if (cache) {
+        // 之后本线程释放的内存块按其他线程处理
+        s_cache = nullptr;
+        cache->exit();
+    }
+}
+
+} // namespace
+
+void* BufferPool::allocate(size_t size, size_t& capacity) {
+    if (!size) size = 1;
+    if (size > classSize(CLASS_COUNT - 1)) {
+        auto header = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + size));
+        if (!header) {
+            throw std::bad_alloc();
+        }
+        header->owner = nullptr;
+        header->sizeClass = NO_CLASS;
+        capacity = size;
+        return toUser(header);
+    }
+
+    auto sizeClass = sizeToClass(size);
+    capacity = classSize(sizeClass);
+    if (s_cache) {
+        return s_cache->allocate(sizeClass);
+    }
+
+    auto header = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + capacity));
+    if (!header) {
+        throw std::bad_alloc();
+    }
+    header->owner = nullptr;
+    header->sizeClass = sizeClass;
+    return toUser(header);
+}
+
+void BufferPool::deallocate(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    auto header = toHeader(ptr);
+    auto owner = header->owner;
+    if (!owner) {
+        free(header);
+    } else if (owner == s_cache) {
+        owner->deallocateLocal(header);
+    } else {
+        owner->deallocateRemote(header);
+    }
+}
+
+void BufferPool::enableThreadCache() {
+    if (s_cache) {
+        return;
+    }
+    s_cache = new ThreadCache();
+    s_holder.cache = s_cache;
+}
+
+} // namespace myNet
@@ -0,0 +1,57 @@
+#ifndef BufferPool_hpp
+#define BufferPool_hpp
+
+#include <cstddef>
+#include <memory>
+
+namespace myNet {
+
+// 按2的幂分级的内存池, 每个启用缓存的线程(EventPoller 线程) 持有各级空闲链表
+// 本线程释放直接放回空闲链表, 其他线程释放时无锁归还到所属线程, 由所属线程下次分配时回收
+// 未启用缓存的线程以及超出最大级别的请求直接使用malloc/free
+class BufferPool {
+  public:
+    // 分配至少size 字节, capacity 返回实际可用大小
+    static void* allocate(size_t size, size_t& capacity);
+
+    static void* allocate(size_t size) {
+        size_t capacity;
+        return allocate(size, capacity);
+    }
+
+    // 可在任意线程释放
+    static void deallocate(void* ptr);
+
+    // 为当前线程启用缓存, 线程退出时自动释放
+    static void enableThreadCache();
+
+  private:
+    BufferPool() = delete;
+};
+
+// 供allocate_shared 使用, 使对象和控制块也从内存池分配
+template <typename T> class BufferPoolAllocator {
+  public:
+    using value_type = T;
+
+    BufferPoolAllocator() = default;
+    template <typename U> BufferPoolAllocator(const BufferPoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(BufferPool::allocate(n * sizeof(T)));
+    }
+    void deallocate(T* ptr, size_t) {
+        BufferPool::deallocate(ptr);
+    }
+
+    template <typename U> bool operator==(const BufferPoolAllocator<U>&) const {
+        return true;
+    }
+    template <typename U> bool operator!=(const BufferPoolAllocator<U>&) const {
+        return false;
+    }
+};
+
+} // namespace myNet
+
+#endif // BufferPool_hpp
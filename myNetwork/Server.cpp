@@ -2,6 +2,29 @@
 
 namespace myNet {
 
+Server::Server(EventPoller::Ptr poller) {
+    _poller = (poller ? poller : EventPollerPool::Instance().getPoller());
+    _counters = std::make_shared<std::unordered_map<const EventPoller*, TrafficCounters::Ptr>>();
+    _counters->emplace(_poller.get(), std::make_shared<TrafficCounters>());
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr& executor) {
+        auto poller = std::dynamic_pointer_cast<EventPoller>(executor);
+        if (poller) _counters->emplace(poller.get(), std::make_shared<TrafficCounters>());
+    });
+}
+
+TrafficStats Server::getStats() const {
+    TrafficStats stats;
+    for (auto& [_, counters] : *_counters) {
+        stats += counters->snapshot();
+    }
+    return stats;
+}
+
+TrafficCounters::Ptr Server::getCounters(const EventPoller* poller) const {
+    auto it = _counters->find(poller);
+    return it == _counters->end() ? nullptr : it->second;
+}
+
 Session::Ptr SessionMap::get(const std::string& tag) {
     std::lock_guard<std::mutex> lck(_mtx);
     auto it = _mapSession.find(tag);
@@ -63,13 +63,19 @@ class Server : public std::enable_shared_from_this<Server> {
   public:
     using Ptr = std::shared_ptr<Server>;
 
-    explicit Server(EventPoller::Ptr poller = nullptr) {
-        _poller = (poller ? poller : EventPollerPool::Instance().getPoller());
-    };
+    explicit Server(EventPoller::Ptr poller = nullptr);
     virtual ~Server() = default;
 
+    // 汇总本server 所有连接的收发统计(包含各poller 上的克隆), 任意线程可调用
+    TrafficStats getStats() const;
+
   protected:
+    // 该poller 上的连接使用的计数器
+    TrafficCounters::Ptr getCounters(const EventPoller* poller) const;
+
     EventPoller::Ptr _poller;
+    // 每个poller 一个计数器, 各poller 线程只累加自己的, 构造后只读; 克隆与原server 共用
+    std::shared_ptr<std::unordered_map<const EventPoller*, TrafficCounters::Ptr>> _counters;
 };
 
 } // namespace myNet
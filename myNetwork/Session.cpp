@@ -12,6 +12,13 @@ void myNet::Session::safeShutdown(const SocketException& ex) {
     });
 }
 
+void Session::enableRecvChain() {
+    if (!_recvChain) {
+        _recvChain = std::make_shared<BufferChain>();
+    }
+    getSocket()->enableRecvSlab();
+}
+
 std::string myNet::Session::getIdentifier() const {
     if (_id.empty()) {
         _id = std::to_string(++SessionIndex) + "-" + std::to_string(getSocket()->getFd());
@@ -4,6 +4,7 @@
 #include <atomic>
 #include <memory>
 
+#include "BufferChain.hpp"
 #include "Socket.hpp"
 
 namespace myNet {
@@ -24,6 +25,17 @@ class Session : public std::enable_shared_from_this<Session>, public SocketHelpe
     // 数据接收
     virtual void onRecv(const Buffer::Ptr& buf) = 0;
 
+    // 开启后接收的数据追加到会话的BufferChain 并回调onRecvChain, 不再回调onRecv
+    // socket 同时切换为接收slab 模式, 追加时无需拷贝; 需在poller 线程调用(如构造函数中)
+    void enableRecvChain();
+
+    const BufferChain::Ptr& getRecvChain() const {
+        return _recvChain;
+    }
+
+    // 开启BufferChain 后的数据接收, 已处理的数据需调用consume 移除
+    virtual void onRecvChain(BufferChain& chain) {}
+
     virtual void onErr(const SocketException& err) = 0;
 
     // 超时管理
@@ -36,6 +48,7 @@ class Session : public std::enable_shared_from_this<Session>, public SocketHelpe
 
   private:
     mutable std::string _id;
+    BufferChain::Ptr _recvChain;
 };
 
 class TCPSession : public Session {};
@@ -1,5 +1,6 @@
 #include "Socket.hpp"
 
+#include <cstdlib>
 #include <type_traits>
 
 #include "SocketUtil.hpp"
@@ -10,8 +11,48 @@
 #include "Util/logger.h"
 #include "uv_errno.hpp"
 
+// 接收slab 模式下单次读取的最小空间
+#define RECV_SLAB_MIN_SIZE (4 * 1024)
+// udp 数据报最大长度
+#define UDP_MAX_DATAGRAM_SIZE (64 * 1024)
+// 批量接收的初始批大小
+#define RECV_BATCH_INIT_SIZE 8
+// 批量接收单个socket 的槽位总大小上限, 开启UDP_GRO(每槽64KB) 时限制批大小为64
+#define RECV_BATCH_MAX_BYTES (4 * 1024 * 1024)
+
 namespace myNet {
 
+// 批量接收使用的缓存与消息头, 每个数据报一个槽位
+struct Socket::RecvBatch {
+    size_t maxBatch;
+    size_t slotSize;
+    // 当前批大小, 批次收满时翻倍, 不足四分之一时减半
+    size_t batch;
+    std::vector<BufferRaw::Ptr> buffers;
+    std::vector<sockaddr_storage> addrs;
+    std::vector<iovec> iovecs;
+    std::vector<mmsghdr> hdrs;
+    // UDP_GRO 控制信息
+    std::vector<char> controls;
+    std::vector<RecvDatagram> datagrams;
+
+    RecvBatch(size_t maxBatch, size_t slotSize)
+        : maxBatch(maxBatch), slotSize(slotSize), batch(std::min(maxBatch, (size_t)RECV_BATCH_INIT_SIZE)), buffers(maxBatch), addrs(maxBatch), iovecs(maxBatch), hdrs(maxBatch),
+          controls(maxBatch * CMSG_SPACE(sizeof(int))) {
+        datagrams.reserve(maxBatch);
+    }
+};
+
+// UDP_GRO 合并的原数据报长度, 未合并时返回0
+static int getGroSize(msghdr& msg) {
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            return *(int*)CMSG_DATA(cmsg);
+        }
+    }
+    return 0;
+}
+
 static SocketException toSocketException(int error) {
     switch (error) {
     case 0:
@@ -35,10 +76,12 @@ static SocketException getSocketErr(const SocketFD::Ptr& sock) {
 
 Socket::Socket(const EventPoller::Ptr poller, bool enableMutex) : _mtxEvent(enableMutex), _mtxSocketFd(enableMutex), _mtxSendBufSending(enableMutex), _mtxSendBufWaiting(enableMutex), _poller(poller) {
     if (_poller == nullptr) _poller = EventPollerPool::Instance().getPoller();
+    _iovecCache = std::make_shared<IovecCache>();
 
     setOnRead(nullptr);
     setOnErr(nullptr);
     setOnAccept(nullptr);
+    setOnAcceptFilter(nullptr);
     setOnFlush(nullptr);
     setOnCreateSocket(nullptr);
     setOnSendResult(nullptr);
@@ -54,46 +97,71 @@ Socket::Ptr Socket::createSocket(const EventPoller::Ptr& poller, bool enable_mut
 }
 
 void Socket::setOnRead(onReadCB&& readCB) {
-    std::lock_guard<MutexWrapper> lck(_mtxEvent);
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
     if (readCB != nullptr) {
         _onReadCB = readCB;
     } else {
         _onReadCB = [](const Buffer::Ptr& buf, sockaddr* addr, int addrLen) { WarnL << "Socket not set read callback, data: " << buf->size(); };
     }
 }
+void Socket::setOnReadBatch(onReadBatchCB&& readBatchCB) {
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
+    _onReadBatchCB = readBatchCB;
+}
 void Socket::setOnErr(onErrCB&& errCB) {
-    std::lock_guard<MutexWrapper> lck(_mtxEvent);
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
     if (errCB != nullptr)
         _onErrCB = errCB;
     else
         _onErrCB = [](const SocketException& err) { WarnL << "Socket not set err callback, err: " << err.what(); };
 }
 void Socket::setOnAccept(onAcceptCB&& acceptCB) {
-    std::lock_guard<MutexWrapper> lck(_mtxEvent);
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
     if (acceptCB != nullptr)
         _onAcceptCB = acceptCB;
     else
         _onAcceptCB = [](Ptr& sock, std::shared_ptr<void>& complete) { WarnL << "Socket not set accept callback, peer fd: " << sock->getFd(); };
 }
+void Socket::setOnAcceptFilter(onAcceptFilterCB&& filterCB) {
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
+    if (filterCB != nullptr)
+        _onAcceptFilterCB = filterCB;
+    else
+        _onAcceptFilterCB = [](const sockaddr* addr, socklen_t addrLen) { return true; };
+}
+void Socket::setOnAcceptBatch(onAcceptBatchCB&& batchCB) {
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
+    _onAcceptBatchCB = batchCB;
+}
 void Socket::setOnFlush(onFlushCB&& flushCB) {
-    std::lock_guard<MutexWrapper> lck(_mtxEvent);
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
     if (flushCB != nullptr)
         _onFlushCB = flushCB;
     else
         _onFlushCB = []() { return true; };
 };
 void Socket::setOnCreateSocket(onCreateSocketCB&& createSocketCB) {
-    std::lock_guard<MutexWrapper> lck(_mtxEvent);
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
     if (createSocketCB != nullptr)
         _onCreateSocketCB = createSocketCB;
     else
         _onCreateSocketCB = [](const EventPoller::Ptr& poller) { return nullptr; };
 };
 void Socket::setOnSendResult(onSendResultCB&& sendResultCB) {
-    std::lock_guard<MutexWrapper> lck(_mtxEvent);
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
     _onSendResultCB = sendResultCB;
 };
 
+void Socket::setOnSendBlocked(onSendWatermarkCB&& blockedCB) {
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
+    _onSendBlockedCB = blockedCB;
+}
+
+void Socket::setOnSendDrained(onSendWatermarkCB&& drainedCB) {
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
+    _onSendDrainedCB = drainedCB;
+}
+
 void Socket::connect(const std ::string& url, uint16_t port, const onErrCB& errCB, float timeoutSec, const std::string& localIP, uint16_t localPort) {
     std::weak_ptr<Socket> weakThis = shared_from_this();
     // 异步执行
@@ -115,8 +183,8 @@ void Socket::connect(const std ::string& url, uint16_t port, const onErrCB& errC
             sharedThis->_asyncConnectCB = nullptr;
             sharedThis->_conTime = nullptr;
             if (err) {
-                std::lock_guard<MutexWrapper> lck(sharedThis->_mtxSocketFd);
-                sharedThis->_socketFd = nullptr;
+                std::lock_guard<SocketMutex> lck(sharedThis->_mtxSocketFd);
+                sharedThis->setSocketFd(nullptr);
             }
             errCB(err);
         };
@@ -154,18 +222,18 @@ void Socket::connect(const std ::string& url, uint16_t port, const onErrCB& errC
             }
 
             // set fd
-            std::lock_guard<MutexWrapper> lck(sharedThis->_mtxSocketFd);
-            sharedThis->_socketFd = std::move(sockFdClass);
+            std::lock_guard<SocketMutex> lck(sharedThis->_mtxSocketFd);
+            sharedThis->setSocketFd(std::move(sockFdClass));
         });
 
         // 如果url是ip就在该线程执行，否则异步解析dns
         if (toolkit::isIP(url.data())) {
             // 都是异步执行的，所以这个地方第三个参数都是true
-            (*asyncConnectCB)(SocketUtil::connect(url.data(), port, true, localIP.data(), localPort));
+            (*asyncConnectCB)(SocketUtil::connect(url.data(), port, true, localIP.data(), localPort, _fastOpen));
         } else {
             std::weak_ptr<std::function<void(int)>> weakTask = asyncConnectCB;
-            WorkThreadPool::Instance().getExecutor()->async([url, port, localIP, localPort, weakTask, poller = _poller]() {
-                int tsocketFd = SocketUtil::connect(url.data(), port, true, localIP.data(), localPort);
+            WorkThreadPool::Instance().getExecutor()->async([url, port, localIP, localPort, weakTask, poller = _poller, fastOpen = _fastOpen]() {
+                int tsocketFd = SocketUtil::connect(url.data(), port, true, localIP.data(), localPort, fastOpen);
                 poller->async([weakTask, tsocketFd]() {
                     auto sharedTask = weakTask.lock();
                     if (sharedTask) {
@@ -224,92 +292,190 @@ bool Socket::attachEvent(const SocketFD::Ptr& sock) {
         if (sharedThis && sharedSock) {
             if (event & EventPoller::Event_Read) sharedThis->onRead(sharedSock, isUDP);
             if (event & EventPoller::Event_Write) sharedThis->onWriteable(sharedSock);
-            if (event & EventPoller::Event_Error) sharedThis->emitErr(getSocketErr(sharedSock));
+            if (event & EventPoller::Event_Error) sharedThis->onError(sharedSock);
         }
     });
 }
 
 int Socket::onAccept(const SocketFD::Ptr& sock, int event) noexcept {
-    int fd;
-    while (true) {
-        if (event & EventPoller::Event_Read) {
-            do {
-                fd = static_cast<int>(accept(sock->getFd(), nullptr, nullptr));
-            } while (-1 == fd && UV_EINTR == uv_translate_posix_error(errno));
-            if (fd == -1) {
-                if (UV_EAGAIN == uv_translate_posix_error(errno)) {
-                    return 0;
+    if (event & EventPoller::Event_Read) {
+        bool drained{false};
+        for (size_t count = 0; _acceptBatch == 0 || count < _acceptBatch; ++count) {
+            // 监听被暂停(过载保护), 等待enableRecv(true) 重新注册读事件
+            if (!_enableRecv) {
+                drained = true;
+                break;
+            }
+
+            // accept4 直接设置非阻塞和FD_CLOEXEC, 其余选项继承自监听socket
+            AcceptedFd accepted;
+            accepted.fd = SocketUtil::accept(sock->getFd(), accepted.addr, accepted.addrLen);
+            if (accepted.fd == -1) {
+                auto err = uv_translate_posix_error(errno);
+                if (UV_EAGAIN == err) {
+                    drained = true;
+                    break;
                 } // 没有新连接
-                emitErr(toSocketException(errno));
+                flushAcceptBatch();
+                emitErr(toSocketException(err));
                 // 错误信息：Accept socket faild
                 return -1;
             }
 
-            // SocketUtil::setNoSigpipe(fd);
-            SocketUtil::setNoBlocked(fd);
-            SocketUtil::setNoDelay(fd);
-            SocketUtil::setSendBuf(fd);
-            SocketUtil::setRecvBuf(fd);
-            SocketUtil::setCloseWait(fd);
-            SocketUtil::setCloExec(fd);
-
-            Socket::Ptr peerSock;
+            bool admitted{true};
             try {
-                // 为什么捕获异常？
-                std::lock_guard<MutexWrapper> lck(_mtxEvent);
-                peerSock = _onCreateSocketCB(_poller);
+                std::lock_guard<SocketMutex> lck(_mtxEvent);
+                admitted = _onAcceptFilterCB((sockaddr*)&accepted.addr, accepted.addrLen);
             } catch (std::exception& e) {
-                ErrorL << "Exception occurred when emit on_before_accept: " << e.what();
-                close(fd);
+                ErrorL << "Exception occurred when emit on_accept_filter: " << e.what();
+            }
+            if (!admitted) {
+                close(accepted.fd);
                 continue;
             }
 
-            if (!peerSock) {
-                // 共用poller并关闭互斥锁
-                peerSock = createSocket(_poller, false);
+            if (_onAcceptBatchCB) {
+                _acceptedFds.emplace_back(accepted);
+                continue;
             }
+            onAcceptPeer(accepted);
+        }
+        flushAcceptBatch();
+
+        if (!drained) {
+            // 本轮已达上限, 边沿触发不会再通知, 剩余连接放到下一轮任务中处理, 避免连接风暴时独占poller
+            std::weak_ptr<Socket> weakThis = shared_from_this();
+            std::weak_ptr<SocketFD> weakSock = sock;
+            _poller->async(
+                [weakThis, weakSock]() {
+                    auto sharedThis = weakThis.lock();
+                    auto sharedSock = weakSock.lock();
+                    if (sharedThis && sharedSock) sharedThis->onAccept(sharedSock, EventPoller::Event_Read);
+                },
+                false);
+        }
+    }
 
-            auto peerSockFd = peerSock->setPeerSock(fd);
+    if (event & EventPoller::Event_Error) {
+        auto ex = getSocketErr(sock);
+        emitErr(ex);
+        ErrorL << "TCP listener occurred a err: " << ex.what();
+        return -1;
+    }
+    return 0;
+}
 
-            std::shared_ptr<void> completed(nullptr, [peerSock, peerSockFd](void*) {
-                try {
-                    if (!peerSock->attachEvent(peerSockFd)) {
-                        peerSock->emitErr(SocketException(Errcode::Err_eof, "Add event to poller failed when accept a socket."));
-                    }
-                } catch (std::exception& e) {
-                    ErrorL << "Exception occurred: " << e.what();
-                }
-            });
+void Socket::onAcceptPeer(const AcceptedFd& accepted) noexcept {
+    Socket::Ptr peerSock;
+    try {
+        // 为什么捕获异常？
+        std::lock_guard<SocketMutex> lck(_mtxEvent);
+        peerSock = _onCreateSocketCB(_poller);
+    } catch (std::exception& e) {
+        ErrorL << "Exception occurred when emit on_before_accept: " << e.what();
+        close(accepted.fd);
+        return;
+    }
 
-            try {
-                std::lock_guard<MutexWrapper> lck(_mtxEvent);
-                _onAcceptCB(peerSock, completed);
-            } catch (std::exception& e) {
-                ErrorL << "Exception occurred when emit on_accept: " << e.what();
-                continue;
+    if (!peerSock) {
+        // 共用poller并关闭互斥锁
+        peerSock = createSocket(_poller, false);
+    }
+
+    auto peerSockFd = peerSock->setPeerSock(accepted.fd, (sockaddr*)&accepted.addr, accepted.addrLen);
+
+    std::shared_ptr<void> completed(nullptr, [peerSock, peerSockFd](void*) {
+        try {
+            if (!peerSock->attachEvent(peerSockFd)) {
+                peerSock->emitErr(SocketException(Errcode::Err_eof, "Add event to poller failed when accept a socket."));
             }
+        } catch (std::exception& e) {
+            ErrorL << "Exception occurred: " << e.what();
         }
+    });
 
-        if (event & EventPoller::Event_Error) {
-            auto ex = getSocketErr(sock);
-            emitErr(ex);
-            ErrorL << "TCP listener occurred a err: " << ex.what();
-            return -1;
-        }
+    try {
+        std::lock_guard<SocketMutex> lck(_mtxEvent);
+        _onAcceptCB(peerSock, completed);
+    } catch (std::exception& e) {
+        ErrorL << "Exception occurred when emit on_accept: " << e.what();
     }
 }
 
+void Socket::flushAcceptBatch() noexcept {
+    if (_acceptedFds.empty()) {
+        return;
+    }
+    try {
+        std::lock_guard<SocketMutex> lck(_mtxEvent);
+        _onAcceptBatchCB(_acceptedFds);
+    } catch (std::exception& e) {
+        ErrorL << "Exception occurred when emit on_accept_batch: " << e.what();
+    }
+    _acceptedFds.clear();
+}
+
 ssize_t Socket::onRead(const SocketFD::Ptr& sock, bool isUdp) noexcept {
+    if (isUdp) {
+        if (_recvBatchMax) {
+            return onReadBatch(sock);
+        }
+        _recvBatch = nullptr;
+    }
+
     ssize_t accum = 0, nread = 0;
     sockaddr_storage addr;
-    socklen_t len = sizeof(addr);
+    socklen_t len;
     auto buf = _readBuffer->data();
-    auto capacity = _readBuffer->getCapacity() - 1;
+    size_t capacity = _readBuffer->getCapacity() - 1;
+
+    bool gro = isUdp && _udpGro;
+    int groSize = 0;
+    char control[CMSG_SPACE(sizeof(int))];
+
+    bool adaptive = !isUdp && _adaptiveRead;
+    size_t calls = 0;
 
     while (_enableRecv) {
-        do {
-            nread = recvfrom(sock->getFd(), buf, capacity, 0, (sockaddr*)&addr, &len);
-        } while (-1 == nread && UV_EINTR == uv_translate_posix_error(errno)); // 4: Interrupted system call
+        if (readBudgetExhausted(calls++, accum)) {
+            resumeRead(sock);
+            return accum;
+        }
+        len = sizeof(addr);
+        if (_recvSlab) {
+            // udp 需保证能容纳一个完整的数据报
+            // 自适应时按预估长度预留, 但不超过64KB, 避免每次读取都换新的slab
+            buf = _poller->getRecvSlab().prepare(isUdp ? UDP_MAX_DATAGRAM_SIZE : (adaptive ? std::min(_readSize, (size_t)UDP_MAX_DATAGRAM_SIZE) : RECV_SLAB_MIN_SIZE), capacity);
+        }
+        // 自适应时只读取预估长度, 小消息不会用到整个读缓存
+        size_t readSize = adaptive ? std::min(capacity, _readSize) : capacity;
+        if (gro) {
+            // 需读取控制信息获取合并的数据报长度
+            iovec iov{buf, capacity};
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name = &addr;
+            msg.msg_namelen = len;
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            do {
+                nread = recvmsg(sock->getFd(), &msg, 0);
+            } while (-1 == nread && UV_EINTR == uv_translate_posix_error(errno));
+            len = msg.msg_namelen;
+            groSize = nread > 0 ? getGroSize(msg) : 0;
+        } else {
+            do {
+                nread = recvfrom(sock->getFd(), buf, readSize, 0, (sockaddr*)&addr, &len);
+            } while (-1 == nread && UV_EINTR == uv_translate_posix_error(errno)); // 4: Interrupted system call
+        }
+
+        if (nread > 0) {
+            countRecv(nread, groSize && nread > groSize ? (nread + groSize - 1) / groSize : 1, 1);
+        } else {
+            countRecv(0, 0, 1);
+        }
 
         if (nread == 0) { // 连接中断或eof时会返回0
             if (isUdp) {
@@ -331,19 +497,187 @@ ssize_t Socket::onRead(const SocketFD::Ptr& sock, bool isUdp) noexcept {
             return accum;
         }
 
-        if (_enableSpeed) _recvSpeed += nread;
+        if (adaptive) updateReadSize(sock, nread, readSize);
 
+        if (accum == 0) _recvTicker.resetTime();
         accum += nread;
-        buf[nread] = '\0';
-        _readBuffer->setSize(nread);
+        Buffer::Ptr readBuffer;
+        if (_recvSlab) {
+            readBuffer = _poller->getRecvSlab().commit(nread);
+        } else {
+            buf[nread] = '\0';
+            _readBuffer->setSize(nread);
+            readBuffer = _readBuffer;
+        }
+
+        if (!isUdp && _autoCork) {
+            cork(sock);
+        }
 
         // 触发回调,处理buf
-        std::lock_guard<MutexWrapper> lck(_mtxEvent);
-        _onReadCB(_readBuffer, (sockaddr*)&addr, len); // 异常处理？
+        std::lock_guard<SocketMutex> lck(_mtxEvent);
+        if (groSize && nread > groSize) {
+            // 按原数据报拆分
+            for (ssize_t offset = 0; offset < nread; offset += groSize) {
+                _onReadCB(BufferSlice::create(readBuffer, offset, std::min((ssize_t)groSize, nread - offset)), (sockaddr*)&addr, len);
+            }
+        } else {
+            _onReadCB(readBuffer, (sockaddr*)&addr, len); // 异常处理？
+        }
     }
     return 0;
 };
 
+bool Socket::readBudgetExhausted(size_t calls, size_t bytes) const {
+    size_t budgetCalls = _readBudgetCalls, budgetBytes = _readBudgetBytes;
+    return (budgetCalls && calls >= budgetCalls) || (budgetBytes && bytes >= budgetBytes);
+}
+
+void Socket::resumeRead(const SocketFD::Ptr& sock) {
+    if (_readResumePending) {
+        return;
+    }
+    // 边沿触发不会再通知, 剩余数据放到下一轮任务中读取, 期间其他socket 的事件得以处理
+    _readResumePending = true;
+    std::weak_ptr<Socket> weakThis = shared_from_this();
+    std::weak_ptr<SocketFD> weakSock = sock;
+    bool isUdp = sock->getType() == SocketType::Socket_UDP;
+    _poller->async(
+        [weakThis, weakSock, isUdp]() {
+            auto sharedThis = weakThis.lock();
+            auto sharedSock = weakSock.lock();
+            if (!sharedThis) return;
+            sharedThis->_readResumePending = false;
+            if (sharedSock) sharedThis->onRead(sharedSock, isUdp);
+        },
+        false);
+}
+
+void Socket::updateReadSize(const SocketFD::Ptr& sock, size_t nread, size_t readSize) {
+    // 最近读取长度的指数加权平均, 权重1/8
+    _readAvg = _readAvg - _readAvg / 8 + nread / 8;
+    size_t want;
+    int pending = 0;
+    if (nread == readSize && 0 == ioctl(sock->getFd(), FIONREAD, &pending) && pending > 0) {
+        // 读满且仍有数据, 按内核中待读的数据量放大
+        want = nread + pending;
+    } else {
+        want = _readAvg * 2;
+    }
+    size_t size = READ_SIZE_MIN;
+    while (size < want && size < SOCKET_DEFAULT_BUF_SIZE) size <<= 1;
+    _readSize = size;
+}
+
+ssize_t Socket::onReadBatch(const SocketFD::Ptr& sock) noexcept {
+    // 合并后的数据报最大64KB
+    bool gro = _udpGro;
+    size_t slotSize = gro ? std::max(_recvBatchSlot.load(), (size_t)UDP_MAX_DATAGRAM_SIZE) : _recvBatchSlot.load();
+    // 槽位较大时缩小批大小, 避免单个socket 占用过多内存
+    size_t maxBatch = std::max<size_t>(1, std::min<size_t>(_recvBatchMax, RECV_BATCH_MAX_BYTES / slotSize));
+    if (!_recvBatch || _recvBatch->maxBatch != maxBatch || _recvBatch->slotSize != slotSize) {
+        _recvBatch.reset(new RecvBatch(maxBatch, slotSize));
+    }
+    auto& batch = *_recvBatch;
+    ssize_t accum = 0;
+
+    size_t calls = 0;
+
+    while (_enableRecv) {
+        if (readBudgetExhausted(calls++, accum)) {
+            resumeRead(sock);
+            return accum;
+        }
+        auto count = batch.batch;
+        for (size_t i = 0; i < count; ++i) {
+            auto& buf = batch.buffers[i];
+            // 上次的缓存被回调保存时换一个新的, 否则直接复用
+            if (!buf || buf.use_count() > 1) {
+                buf = BufferRaw::create();
+                buf->setCapacity(batch.slotSize + 1);
+            } else {
+                std::atomic_thread_fence(std::memory_order_acquire);
+            }
+            batch.iovecs[i].iov_base = buf->data();
+            batch.iovecs[i].iov_len = batch.slotSize;
+
+            auto& msg = batch.hdrs[i].msg_hdr;
+            msg.msg_name = &batch.addrs[i];
+            msg.msg_namelen = sizeof(sockaddr_storage);
+            msg.msg_iov = &batch.iovecs[i];
+            msg.msg_iovlen = 1;
+            msg.msg_control = gro ? &batch.controls[i * CMSG_SPACE(sizeof(int))] : nullptr;
+            msg.msg_controllen = gro ? CMSG_SPACE(sizeof(int)) : 0;
+            msg.msg_flags = 0;
+        }
+
+        int nread;
+        do {
+            nread = recvmmsg(sock->getFd(), batch.hdrs.data(), count, 0, nullptr);
+        } while (-1 == nread && UV_EINTR == uv_translate_posix_error(errno));
+
+        if (nread == -1) {
+            countRecv(0, 0, 1);
+            auto err = uv_translate_posix_error(errno);
+            if (UV_EAGAIN != err) {
+                WarnL << "Recv err on udp socket[" << sock->getFd() << "]: " << uv_strerror(err);
+            }
+            return accum;
+        }
+
+        // 按积压情况调整批大小
+        if ((size_t)nread == count) {
+            batch.batch = std::min(count * 2, batch.maxBatch);
+        } else if ((size_t)nread < count / 4) {
+            batch.batch = std::max(count / 2, (size_t)1);
+        }
+
+        if (accum == 0) _recvTicker.resetTime();
+        auto before = accum;
+        for (int i = 0; i < nread; ++i) {
+            auto& msg = batch.hdrs[i].msg_hdr;
+            auto size = batch.hdrs[i].msg_len;
+            if (msg.msg_flags & MSG_TRUNC) {
+                WarnL << "Udp datagram larger than " << batch.slotSize << " bytes dropped, socket[" << sock->getFd() << "]";
+                continue;
+            }
+            accum += size;
+            auto& buf = batch.buffers[i];
+            buf->data()[size] = '\0';
+            buf->setSize(size);
+            auto groSize = gro ? (size_t)getGroSize(msg) : 0;
+            if (groSize && size > groSize) {
+                // 按原数据报拆分
+                for (size_t offset = 0; offset < size; offset += groSize) {
+                    batch.datagrams.emplace_back(RecvDatagram{BufferSlice::create(buf, offset, std::min(groSize, size - offset)), (sockaddr*)msg.msg_name, msg.msg_namelen});
+                }
+            } else {
+                batch.datagrams.emplace_back(RecvDatagram{buf, (sockaddr*)msg.msg_name, msg.msg_namelen});
+            }
+        }
+
+        countRecv(accum - before, batch.datagrams.size(), 1);
+
+        {
+            std::lock_guard<SocketMutex> lck(_mtxEvent);
+            if (_onReadBatchCB) {
+                _onReadBatchCB(batch.datagrams);
+            } else {
+                for (auto& datagram : batch.datagrams) {
+                    _onReadCB(datagram.buffer, datagram.addr, datagram.addrLen);
+                }
+            }
+        }
+        batch.datagrams.clear();
+
+        // 已读空
+        if ((size_t)nread < count) {
+            return accum;
+        }
+    }
+    return accum;
+}
+
 // private方法
 bool Socket::listen(const SocketFD::Ptr& sock) {
     closeSocket();
@@ -358,13 +692,78 @@ bool Socket::listen(const SocketFD::Ptr& sock) {
         }))
         return false;
 
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
-    _socketFd = std::move(sock); // 要不要右值？原代码没有-----------注意shared_ptr的右值构造函数。这个地方sock是const的，有没有move没关系，否则sock会被swap析构
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+    setSocketFd(std::move(sock)); // 要不要右值？原代码没有-----------注意shared_ptr的右值构造函数。这个地方sock是const的，有没有move没关系，否则sock会被swap析构
     return true;
 }
 
-bool Socket::listen(uint16_t port, const std::string& localIP, int backLog) {
-    int sock = SocketUtil::listen(port, localIP.data(), backLog); // 实现？
+void Socket::enableRecvSlab(bool enable) {
+    _recvSlab = enable;
+}
+
+bool Socket::enableZeroCopy(size_t threshold) {
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+    if (!_socketFd || _socketFd->getType() != SocketType::Socket_TCP) {
+        return false;
+    }
+    if (!_socketFd->getZeroCopy()) {
+        if (-1 == SocketUtil::setZeroCopy(_socketFd->getFd())) {
+            return false;
+        }
+        _socketFd->setZeroCopy(std::make_shared<ZeroCopyTracker>(threshold));
+    }
+    return true;
+}
+
+void Socket::setRecvBatch(size_t maxBatch, size_t slotSize) {
+    _recvBatchSlot = slotSize;
+    _recvBatchMax = std::min(maxBatch, (size_t)UIO_MAXIOV);
+}
+
+void Socket::setWriteCombine(size_t size) {
+    _combineSize = size;
+}
+
+bool Socket::enableUdpGso(bool enable) {
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+    if (!_socketFd || _socketFd->getType() != SocketType::Socket_UDP) {
+        return false;
+    }
+    // 检测内核是否支持
+    if (enable && -1 == SocketUtil::setUdpSegment(_socketFd->getFd(), 0)) {
+        return false;
+    }
+    _udpGso = enable;
+    return true;
+}
+
+bool Socket::enableUdpGro(bool enable) {
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+    if (!_socketFd || _socketFd->getType() != SocketType::Socket_UDP) {
+        return false;
+    }
+    if (-1 == SocketUtil::setUdpGro(_socketFd->getFd(), enable)) {
+        return false;
+    }
+    _udpGro = enable;
+    return true;
+}
+
+void Socket::setAcceptBatch(size_t batch) {
+    _acceptBatch = batch;
+}
+
+bool Socket::attachPeerFd(int fd, const sockaddr* addr, socklen_t addrLen) {
+    auto sock = setPeerSock(fd, addr, addrLen);
+    if (!attachEvent(sock)) {
+        emitErr(SocketException(Errcode::Err_eof, "Add event to poller failed when attach a socket."));
+        return false;
+    }
+    return true;
+}
+
+bool Socket::listen(uint16_t port, const std::string& localIP, int backLog, int fastOpenQueue) {
+    int sock = SocketUtil::listen(port, localIP.data(), backLog, fastOpenQueue); // 实现？
     if (sock == -1) return false;
     return listen(makeSocketFD(sock, SocketType::Socket_TCP));
 }
@@ -376,35 +775,67 @@ bool Socket::bindUdpSocket(uint16_t port, const std::string& localIP, bool enabl
     if (-1 == fd) return false;
     auto sock = makeSocketFD(fd, SocketType::Socket_UDP);
     if (!attachEvent(sock)) return false;
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
-    _socketFd = std::move(sock);
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+    setSocketFd(std::move(sock));
 
     return true;
 }
 
 ssize_t Socket::send(const char* buf, size_t size, sockaddr* addr, socklen_t addrLen, bool tryFlush) {
     auto bufPtr = BufferRaw::create();
-    bufPtr->assign(buf, strlen(buf));
+    bufPtr->assign(buf, size);
     return send(bufPtr, addr, addrLen, tryFlush);
 };
 ssize_t Socket::send(std::string buf, sockaddr* addr, socklen_t addrLen, bool tryFlush) {
-    return send(std::make_shared<BufferString>(buf), addr, addrLen, tryFlush);
+    return send(std::make_shared<BufferString>(std::move(buf)), addr, addrLen, tryFlush);
 };
 ssize_t Socket::send(Buffer::Ptr buf, sockaddr* addr, socklen_t addrLen, bool tryFlush) {
     if (!buf || buf->size() == 0) {
         return 0;
     }
     auto size = buf->size();
+    SOCKET_ASSERT_OWNER(_sendHandoff || _poller->isCurrentThread());
+
+    if (_sendHandoff && !_poller->isCurrentThread()) {
+        // 未连接或已关闭时数据无法发出, 不入队
+        if (!_hasSocketFd) {
+            return -1;
+        }
+        if (addr != nullptr) {
+            buf = std::make_shared<BufferSock>(std::move(buf), addr, addrLen);
+        }
+        // 水位由poller 线程取出数据时检查, 回调不会在其他线程触发
+        _sendBytes += size;
+        // 队列原本为空时才唤醒poller, 之后的数据由同一次任务取出
+        if (_handoffQueue.push(std::move(buf))) {
+            std::weak_ptr<Socket> weakThis = shared_from_this();
+            _poller->async(
+                [weakThis]() {
+                    if (auto strongThis = weakThis.lock()) strongThis->onSendHandoff();
+                },
+                false);
+        }
+        return size;
+    }
+
+    if (_corked && _poller->isCurrentThread()) {
+        tryFlush = false;
+    }
+
+    if (tryFlush && addr == nullptr && _sendDirect && _poller->isCurrentThread() && sendDirect(buf)) {
+        return size;
+    }
 
     {
-        std::lock_guard<MutexWrapper> lck(_mtxSendBufWaiting);
+        std::lock_guard<SocketMutex> lck(_mtxSendBufWaiting);
         if (addr != nullptr) {
-            WarnL << "ADDDDDDDDDDDDDDDDDDDDDDDDDDR";
             _sendBufWaiting.emplace_back(std::make_shared<BufferSock>(std::move(buf), addr, addrLen));
         } else {
             _sendBufWaiting.emplace_back(std::move(buf));
         }
     }
+    _sendBytes += size;
+    checkSendWatermark();
 
     if (tryFlush && flushAll()) {
         return -1;
@@ -413,8 +844,197 @@ ssize_t Socket::send(Buffer::Ptr buf, sockaddr* addr, socklen_t addrLen, bool tr
     return size;
 };
 
+void Socket::setSendWatermark(size_t high, size_t low) {
+    _sendLowWater = std::min(low, high);
+    _sendHighWater = high;
+    checkSendWatermark();
+}
+
+void Socket::setUpstream(const Ptr& upstream) {
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
+    _upstream = upstream;
+}
+
+void Socket::onSendBytes(size_t bytes) {
+    _sendBytes -= bytes;
+    checkSendWatermark();
+}
+
+void Socket::pauseUpstream(bool pause) {
+    auto upstream = _upstream.lock();
+    if (!upstream) {
+        return;
+    }
+    // 上游socket 通常属于其他poller, 切换到其线程执行; 不同步执行, 保证暂停与恢复按顺序生效
+    std::weak_ptr<Socket> weakUpstream = upstream;
+    upstream->getPoller()->async(
+        [weakUpstream, pause]() {
+            if (auto upstream = weakUpstream.lock()) {
+                upstream->enableRecv(!pause);
+            }
+        },
+        false);
+}
+
+void Socket::checkSendWatermark() {
+    // 大多数情况下状态不变, 不上锁
+    auto high = _sendHighWater.load();
+    auto bytes = _sendBytes.load();
+    if (_sendBlocked ? (high && bytes > _sendLowWater) : (!high || bytes < high)) {
+        return;
+    }
+
+    std::lock_guard<SocketMutex> lck(_mtxEvent);
+    // 回调期间字节数可能再次变化, 直到状态稳定; 关闭水位时解除阻塞
+    while (true) {
+        high = _sendHighWater;
+        bytes = _sendBytes;
+        if (!_sendBlocked && high && bytes >= high) {
+            _sendBlocked = true;
+            pauseUpstream(true);
+            if (_onSendBlockedCB) _onSendBlockedCB();
+        } else if (_sendBlocked && (!high || bytes <= _sendLowWater)) {
+            _sendBlocked = false;
+            pauseUpstream(false);
+            if (_onSendDrainedCB) _onSendDrainedCB();
+        } else {
+            break;
+        }
+    }
+}
+
+bool Socket::sendDirect(const Buffer::Ptr& buf) {
+    if (!_sendable) {
+        return false;
+    }
+    auto size = buf->size();
+    ssize_t n;
+    {
+        std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+        if (!_socketFd || _socketFd->getType() != SocketType::Socket_TCP || !_handoffQueue.empty()) {
+            return false;
+        }
+        // 零拷贝及sendfile 仍走队列
+        auto& zeroCopy = _socketFd->getZeroCopy();
+        if ((zeroCopy && zeroCopy->accept(size)) || dynamic_cast<BufferFile*>(buf.get())) {
+            return false;
+        }
+        // 持有等待队列的锁直到剩余部分入队, 避免其他线程的数据插到前面
+        std::lock_guard<SocketMutex> lck1(_mtxSendBufWaiting);
+        {
+            std::lock_guard<SocketMutex> lck2(_mtxSendBufSending);
+            if (!_sendBufWaiting.empty() || !_sendBufSending.empty()) {
+                return false;
+            }
+        }
+
+        n = ::send(_socketFd->getFd(), buf->data(), size, _sockFlags);
+        if (n < 0 && UV_EAGAIN != uv_translate_posix_error(errno)) {
+            // 其他错误交给普通发送流程处理
+            return false;
+        }
+        if (n != (ssize_t)size) {
+            // 剩余部分入队, 等待可写事件; 入队的是原缓存, 发送结果回调中的缓存与调用方传入的一致
+            _sendBufWaiting.emplace_back(buf);
+            _sendWaitingOffset = std::max<ssize_t>(n, 0);
+            _sendBytes += size - _sendWaitingOffset;
+            startWriteableEvent(_socketFd);
+        }
+    }
+
+    // 回调用户代码前已释放锁, 与flushData 一致
+    if (n == (ssize_t)size) {
+        _sendFlushTicker.resetTime();
+        countSend(n, 1, 1);
+        onSendResultCB sendResultCB;
+        {
+            std::lock_guard<SocketMutex> lck(_mtxEvent);
+            sendResultCB = _onSendResultCB;
+        }
+        if (sendResultCB) sendResultCB(buf, true);
+        return true;
+    }
+    countSend(std::max<ssize_t>(n, 0), 0, 1);
+    checkSendWatermark();
+    return true;
+}
+
+void Socket::setReadBudget(size_t bytes, size_t calls) {
+    _readBudgetBytes = bytes;
+    _readBudgetCalls = calls;
+}
+
+void Socket::enableAdaptiveRead(bool enable) {
+    _adaptiveRead = enable;
+}
+
+void Socket::enableAutoCork(bool enable, bool tcpCork) {
+    _tcpCork = tcpCork;
+    _autoCork = enable;
+}
+
+void Socket::cork(const SocketFD::Ptr& sock) {
+    if (_corked) {
+        return;
+    }
+    _corked = true;
+    bool tcpCork = _tcpCork && 0 == SocketUtil::setCork(sock->getFd(), true);
+    std::weak_ptr<Socket> weakThis = shared_from_this();
+    _poller->addLoopEndTask([weakThis, tcpCork]() {
+        if (auto strongThis = weakThis.lock()) strongThis->uncork(tcpCork);
+    });
+}
+
+void Socket::uncork(bool tcpCork) {
+    _corked = false;
+    flushAll();
+    if (tcpCork) {
+        std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+        if (_socketFd) SocketUtil::setCork(_socketFd->getFd(), false);
+    }
+}
+
+void Socket::enableSendDirect(bool enable) {
+    _sendDirect = enable;
+}
+
+void Socket::enableSendHandoff(bool enable) {
+    _sendHandoff = enable;
+}
+
+void Socket::onSendHandoff() {
+    bool hasSocketFd;
+    {
+        std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+        hasSocketFd = _socketFd != nullptr;
+    }
+    if (!hasSocketFd) {
+        // 入队后socket 已关闭, 丢弃并扣除计数
+        size_t dropped = 0;
+        _handoffQueue.popAll([&dropped](Buffer::Ptr&& buf) { dropped += buf->size(); });
+        if (dropped) onSendBytes(dropped);
+        return;
+    }
+    {
+        std::lock_guard<SocketMutex> lck(_mtxSendBufWaiting);
+        _handoffQueue.popAll([this](Buffer::Ptr&& buf) { _sendBufWaiting.emplace_back(std::move(buf)); });
+    }
+    checkSendWatermark();
+    flushAll();
+}
+
 int Socket::flushAll() {
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
+    if (_sendHandoff && !_poller->isCurrentThread()) {
+        std::weak_ptr<Socket> weakThis = shared_from_this();
+        _poller->async(
+            [weakThis]() {
+                if (auto strongThis = weakThis.lock()) strongThis->onSendHandoff();
+            },
+            false);
+        return 0;
+    }
+    SOCKET_ASSERT_OWNER(_poller->isCurrentThread());
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
     if (!_socketFd) {
         return -1;
     }
@@ -431,7 +1051,7 @@ int Socket::flushAll() {
 
 bool Socket::emitErr(const SocketException& err) noexcept {
     {
-        std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
+        std::lock_guard<SocketMutex> lck(_mtxSocketFd);
         if (!_socketFd) return false; // 执行emitErr时会关闭套接字，_socketFd将被置空
     }
 
@@ -442,13 +1062,14 @@ bool Socket::emitErr(const SocketException& err) noexcept {
         auto sharedThis = weakThis.lock();
         if (!sharedThis) return;
 
-        std::lock_guard<MutexWrapper> lck(sharedThis->_mtxEvent);
+        std::lock_guard<SocketMutex> lck(sharedThis->_mtxEvent);
         sharedThis->_onErrCB(err); // 异常处理？
     });
     return true;
 }
 
 void Socket::enableRecv(bool enabled) {
+    SOCKET_ASSERT_OWNER(_poller->isCurrentThread());
     if (_enableRecv == enabled) return;
     _enableRecv = enabled;
     _poller->modifyEvent(getFd(),
@@ -466,12 +1087,12 @@ bool Socket::isSocketBusy() const {
 
 // 涉及到fd要加锁
 int Socket::getFd() const {
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
     if (!_socketFd) return -1;
     return _socketFd->getFd();
 };
 SocketType Socket::getType() const {
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
     if (!_socketFd) return SocketType::Socket_Invalid;
     return _socketFd->getType();
 };
@@ -482,6 +1103,7 @@ const EventPoller::Ptr& Socket::getPoller() const {
 bool Socket::cloneFromListenSocket(const Socket& socket) {
     auto sock = cloneSocketFd(socket);
     if (sock) {
+        _acceptBatch = socket._acceptBatch;
         return listen(sock);
     }
     return false;
@@ -491,22 +1113,32 @@ bool Socket::cloneFromListenSocket(const Socket& socket) {
 bool Socket::cloneFromPeerSocket(const Socket& socket) {
     auto sock = cloneSocketFd(socket);
     if (sock && attachEvent(sock)) {
-        std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
-        _socketFd = sock;
+        std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+        setSocketFd(sock);
         return true;
     }
     return false;
 };
 
+void Socket::setSocketFd(SocketFD::Ptr sock) {
+    _hasSocketFd = sock != nullptr;
+    _socketFd = std::move(sock);
+}
+
 void Socket::closeSocket() {
     _conTime = nullptr;
     _asyncConnectCB = nullptr;
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
-    _socketFd = nullptr;
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+    if (_socketFd && _socketFd->getZeroCopy()) {
+        // 回调可能引用本对象, 不能等到fd 析构时触发
+        _socketFd->getZeroCopy()->clear();
+    }
+    setSocketFd(nullptr);
+    _peerAddr.ss_family = AF_UNSPEC;
 };
 
 bool Socket::bindPeerAddr(const sockaddr* addr, socklen_t addrLen) {
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
     if (!_socketFd) return false;
     if (_socketFd->getType() != SocketType::Socket_UDP) return false;
 
@@ -523,47 +1155,118 @@ void Socket::setSendFlag(int flags) {
 size_t Socket::getSendBufferCount() const {
     size_t ret = 0;
     {
-        std::lock_guard<MutexWrapper> lck(_mtxSendBufWaiting);
+        std::lock_guard<SocketMutex> lck(_mtxSendBufWaiting);
         ret += _sendBufWaiting.size();
     }
     {
-        std::lock_guard<MutexWrapper> lck(_mtxSendBufSending);
+        std::lock_guard<SocketMutex> lck(_mtxSendBufSending);
         for (auto& b : _sendBufSending) ret += b->count();
     }
 
     return ret;
 };
+size_t Socket::getSendBufferBytes() const {
+    return _sendBytes;
+}
 uint64_t Socket::elapsedTimeAfterFlushed() const {
     return _sendFlushTicker.elapsedTime();
 };
+uint64_t Socket::elapsedTimeAfterRecv() const {
+    return _recvTicker.elapsedTime();
+};
 
 int Socket::getRecvSpeed() {
-    _enableSpeed = true;
-    return _recvSpeed.getSpeed();
+    return _recvSpeed.update(_counters.getRecvBytes());
 };
 int Socket::getSendSpeed() {
-    _enableSpeed = true;
-    return _sendSpeed.getSpeed();
+    return _sendSpeed.update(_counters.getSendBytes());
 };
 
+bool Socket::getTcpInfo(TcpInfo& info) const {
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+    if (!_socketFd || _socketFd->getType() != SocketType::Socket_TCP) {
+        return false;
+    }
+    return 0 == SocketUtil::getTcpInfo(_socketFd->getFd(), info);
+}
+
+// 目标大小为2倍带宽时延积, 与当前值相差不足1/4 时不调整, 避免频繁setsockopt; 返回0 表示不调整
+static int bdpBufSize(const SocketBufPolicy& policy, uint64_t rtt, uint64_t rate, int current) {
+    auto bdp = rtt * rate / 1000000;
+    if (!bdp) {
+        return 0;
+    }
+    auto size = (int)std::min<uint64_t>(std::max<uint64_t>(bdp * 2, policy.minSize), policy.maxSize);
+    if (current && std::abs(size - current) < current / 4) {
+        return 0;
+    }
+    return size;
+}
+
+void Socket::tuneSocketBuf() {
+    auto& policy = SocketUtil::getBufPolicy();
+    if (policy.mode != SocketBufPolicy::Mode::Adaptive) {
+        return;
+    }
+    uint64_t recvRate = _tuneRecvSpeed.update(_counters.getRecvBytes());
+
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+    TcpInfo info;
+    if (!_socketFd || _socketFd->getType() != SocketType::Socket_TCP || 0 != SocketUtil::getTcpInfo(_socketFd->getFd(), info)) {
+        return;
+    }
+    // 发送方向: 平滑rtt × 交付速率, 缩小只会使写入提前阻塞, 可双向调整
+    if (auto size = bdpBufSize(policy, info.rtt, info.deliveryRate, _tunedSendBuf)) {
+        if (0 == SocketUtil::setSendBuf(_socketFd->getFd(), size)) _tunedSendBuf = size;
+    }
+    // 接收方向: 接收rtt × 实测接收速率, 只增不减, 缩小到已通告的窗口以下会使内核丢弃在途数据
+    // 内核返回的是设置值的2倍
+    auto size = bdpBufSize(policy, info.rcvRtt ? info.rcvRtt : info.rtt, recvRate, _tunedRecvBuf);
+    if (size > _tunedRecvBuf && size * 2 > SocketUtil::getRecvBuf(_socketFd->getFd())) {
+        if (0 == SocketUtil::setRecvBuf(_socketFd->getFd(), size)) _tunedRecvBuf = size;
+    }
+}
+
+TrafficStats Socket::getStats() const {
+    return _counters.snapshot();
+}
+
+void Socket::setServerCounters(const TrafficCounters::Ptr& counters) {
+    _serverCounters = counters;
+}
+
+void Socket::countRecv(size_t bytes, size_t packets, size_t calls) {
+    _counters.addRecv(bytes, packets, calls);
+    _poller->getCounters().addRecv(bytes, packets, calls);
+    if (_serverCounters) _serverCounters->addRecv(bytes, packets, calls);
+}
+
+void Socket::countSend(size_t bytes, size_t packets, size_t calls) {
+    _counters.addSend(bytes, packets, calls);
+    _poller->getCounters().addSend(bytes, packets, calls);
+    if (_serverCounters) _serverCounters->addSend(bytes, packets, calls);
+}
+
 std::string Socket::get_localIP() {
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
     if (!_socketFd) return "";
     return SocketUtil::getLocalIp(_socketFd->getFd());
 };
 uint16_t Socket::get_localPort() {
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
     if (!_socketFd) return 0;
     return SocketUtil::getLocalPort(_socketFd->getFd());
 };
 std::string Socket::get_peerIP() {
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
     if (!_socketFd) return "";
+    if (_peerAddr.ss_family != AF_UNSPEC) return SocketUtil::inetNtoa((sockaddr*)&_peerAddr);
     return SocketUtil::getPeerIp(_socketFd->getFd());
 };
 uint16_t Socket::get_peerPort() {
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
     if (!_socketFd) return 0;
+    if (_peerAddr.ss_family != AF_UNSPEC) return SocketUtil::inetPort((sockaddr*)&_peerAddr);
     return SocketUtil::getPeerPort(_socketFd->getFd());
 };
 std::string Socket::getIdentifier() const {
@@ -572,18 +1275,21 @@ std::string Socket::getIdentifier() const {
 
 SocketFD::Ptr Socket::cloneSocketFd(const Socket& sock) {
     SocketFD::Ptr socketFD;
-    std::lock_guard<MutexWrapper> lck(sock._mtxSocketFd);
+    std::lock_guard<SocketMutex> lck(sock._mtxSocketFd);
     if (sock._socketFd) {
         socketFD = std::make_shared<SocketFD>(*(sock._socketFd), _poller);
     }
     return socketFD;
 };
 
-SocketFD::Ptr Socket::setPeerSock(int fd) {
+SocketFD::Ptr Socket::setPeerSock(int fd, const sockaddr* addr, socklen_t addrLen) {
     closeSocket();
     auto sock = makeSocketFD(fd, SocketType::Socket_TCP);
-    std::lock_guard<MutexWrapper> lck(_mtxSocketFd);
-    _socketFd = sock;
+    std::lock_guard<SocketMutex> lck(_mtxSocketFd);
+    setSocketFd(sock);
+    if (addr && addrLen <= sizeof(_peerAddr)) {
+        memcpy(&_peerAddr, addr, addrLen);
+    }
     return sock;
 };
 
@@ -594,11 +1300,11 @@ SocketFD::Ptr Socket::makeSocketFD(int fd, SocketType type) {
 void Socket::onWriteable(const SocketFD::Ptr& sock) {
     bool sendEmpty{false}, waitEmpty{false};
     {
-        std::lock_guard<MutexWrapper> lck(_mtxSendBufWaiting);
+        std::lock_guard<SocketMutex> lck(_mtxSendBufWaiting);
         sendEmpty = _sendBufWaiting.empty();
     }
     {
-        std::lock_guard<MutexWrapper> lck(_mtxSendBufSending);
+        std::lock_guard<SocketMutex> lck(_mtxSendBufSending);
         sendEmpty = _sendBufSending.empty();
     }
     if (sendEmpty && waitEmpty) {
@@ -608,10 +1314,24 @@ void Socket::onWriteable(const SocketFD::Ptr& sock) {
     }
 };
 
+void Socket::onError(const SocketFD::Ptr& sock) {
+    auto& zeroCopy = sock->getZeroCopy();
+    if (zeroCopy) {
+        // 零拷贝完成通知也通过EPOLLERR 上报, SO_ERROR 为0 时不是真正的错误
+        zeroCopy->onErrQueue(sock->getFd());
+        auto err = getSocketErr(sock);
+        if (err) {
+            emitErr(err);
+        }
+        return;
+    }
+    emitErr(getSocketErr(sock));
+}
+
 void Socket::onFlush() {
     bool flag{false};
     {
-        std::lock_guard<MutexWrapper> lck(_mtxEvent);
+        std::lock_guard<SocketMutex> lck(_mtxEvent);
         flag = _onFlushCB();
     }
     if (!flag) {
@@ -631,14 +1351,14 @@ void Socket::stopWriteableEvent(const SocketFD::Ptr& sock) {
 bool Socket::flushData(const SocketFD::Ptr& sock, bool pollerThread) {
     std::list<BufferList::Ptr> sendBufSending;
     {
-        std::lock_guard<MutexWrapper> lck(_mtxSendBufSending);
+        std::lock_guard<SocketMutex> lck(_mtxSendBufSending);
         sendBufSending.swap(_sendBufSending);
     }
 
     if (sendBufSending.empty()) {
         _sendFlushTicker.resetTime();
         {
-            std::lock_guard<MutexWrapper> lck(_mtxSendBufWaiting);
+            std::lock_guard<SocketMutex> lck(_mtxSendBufWaiting);
             // 若无数据可flush
             if (_sendBufWaiting.empty()) {
                 if (pollerThread) {
@@ -648,26 +1368,35 @@ bool Socket::flushData(const SocketFD::Ptr& sock, bool pollerThread) {
                 return true;
             }
 
-            std::lock_guard<MutexWrapper> lck1(_mtxEvent);
-            onSendResultCB sendResultCB;
-            if (_enableSpeed) {
-                sendResultCB = [this](const Buffer::Ptr& buffer, bool sendSuccess) {
-                    if (sendSuccess) {
-                        _sendSpeed += buffer->size();
-                    }
-                    std::lock_guard<MutexWrapper> lck(_mtxEvent);
-                    if (_onSendResultCB) {
-                        _onSendResultCB(buffer, sendSuccess);
-                    }
-                };
-            } else {
-                sendResultCB = _onSendResultCB;
+            std::lock_guard<SocketMutex> lck1(_mtxEvent);
+            onSendResultCB sendResultCB = _onSendResultCB;
+            BufferList::SendOption option;
+            option.isUdp = sock->getType() == SocketType::Socket_UDP;
+            option.udpGso = _udpGso;
+            option.combineSize = _combineSize;
+            option.iovecCache = _iovecCache;
+            option.offset = _sendWaitingOffset;
+            _sendWaitingOffset = 0;
+            if (sock->getZeroCopy()) {
+                size_t bytes = 0;
+                for (auto& buf : _sendBufWaiting) bytes += buf->size();
+                bytes -= option.offset;
+                if (sock->getZeroCopy()->accept(bytes)) option.zeroCopy = sock->getZeroCopy();
             }
-            sendBufSending.emplace_back(BufferList::create(std::move(_sendBufWaiting), std::move(sendResultCB), sock->getType() == SocketType::Socket_UDP));
+            sendBufSending.emplace_back(BufferList::create(std::move(_sendBufWaiting), std::move(sendResultCB), option));
         }
     }
     while (!sendBufSending.empty()) {
-        auto n = sendBufSending.front()->send(sock->getFd(), _sockFlags);
+        auto& front = sendBufSending.front();
+        auto remain = front->remainSize();
+        auto count = front->count();
+        auto syscalls = front->syscalls();
+        auto n = front->send(sock->getFd(), _sockFlags);
+        countSend(remain - front->remainSize(), count - front->count(), front->syscalls() - syscalls);
+        // udp 发送失败的数据报在内部丢弃, 同样计入
+        if (remain != front->remainSize()) {
+            onSendBytes(remain - front->remainSize());
+        }
         // 发送字节数大于0
         if (n > 0) {
             // 全部发送
@@ -691,6 +1420,7 @@ bool Socket::flushData(const SocketFD::Ptr& sock, bool pollerThread) {
 
         // udp发送异常就丢弃数据
         if (sock->getType() == SocketType::Socket_UDP) {
+            onSendBytes(sendBufSending.front()->remainSize());
             sendBufSending.pop_front();
             WarnL << "Send udp socket[" << sock->getFd() << "] failed, data ignored: " << uv_strerror(uv_translate_posix_error(errno));
             continue;
@@ -703,7 +1433,7 @@ bool Socket::flushData(const SocketFD::Ptr& sock, bool pollerThread) {
     // 处理未发送完成的数据
     if (!sendBufSending.empty()) {
         // 有剩余数据
-        std::lock_guard<MutexWrapper> lck(_mtxSendBufSending);
+        std::lock_guard<SocketMutex> lck(_mtxSendBufSending);
         sendBufSending.swap(_sendBufSending);
         for (auto& i : sendBufSending) {
             _sendBufSending.push_back(i);
@@ -733,8 +1463,8 @@ ssize_t SocketSender::send(const char* buf, size_t size) {
     buffer->assign(buf, size);
     return send(std::move(buffer));
 };
-ssize_t SocketSender::send(const std::string buf) {
-    return send(std::make_shared<BufferString>(buf));
+ssize_t SocketSender::send(std::string buf) {
+    return send(std::make_shared<BufferString>(std::move(buf)));
 };
 
 SocketHelper::SocketHelper(const Socket::Ptr& sock) {
@@ -10,13 +10,17 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "Buffer.hpp"
+#include "SocketUtil.hpp"
 // #include "Poller/EventPoller.h"
 #include "../myPoller/EventPoller.hpp"
 // #include "Poller/Timer.h"
 #include "../myPoller/EventPollerApp.hpp"
-#include "Util/SpeedStatistic.h"
+#include "../myThread/MpscQueue.hpp"
+#include "TrafficCounters.hpp"
+#include "Util/TimeTicker.h"
 
 namespace myNet {
 
@@ -110,9 +114,18 @@ class SocketFD : public noncopyable {
         return _num->getType();
     }
 
+    // 零拷贝发送跟踪, 完成序号属于fd, 随fd 一起释放
+    const ZeroCopyTracker::Ptr& getZeroCopy() const {
+        return _zeroCopy;
+    }
+    void setZeroCopy(ZeroCopyTracker::Ptr zeroCopy) {
+        _zeroCopy = std::move(zeroCopy);
+    }
+
   private:
     SocketNum::Ptr _num;
     EventPoller::Ptr _poller;
+    ZeroCopyTracker::Ptr _zeroCopy;
 };
 
 // socket信息
@@ -130,6 +143,36 @@ class SocketInfo {
     }
 };
 
+// accept 得到的原始连接
+struct AcceptedFd {
+    int fd{-1};
+    socklen_t addrLen{0};
+    sockaddr_storage addr;
+};
+
+// 默认合并小于该长度的发送缓存
+#define WRITE_COMBINE_DEFAULT_SIZE 256
+// 自适应读取长度的最小值及初始值
+#define READ_SIZE_MIN (2 * 1024)
+#define READ_SIZE_INIT (16 * 1024)
+
+// 定义MYNET_SINGLE_OWNER_SOCKET(cmake -DSINGLE_OWNER_SOCKET=ON) 时socket 只能在所属poller 线程使用, 内部的锁在编译期消除
+// debug 编译下检查数据路径接口的调用线程; 开启enableSendHandoff 后其他线程仍可send
+#ifdef MYNET_SINGLE_OWNER_SOCKET
+using SocketMutex = NullMutexWrapper;
+#define SOCKET_ASSERT_OWNER(cond) assert(cond)
+#else
+using SocketMutex = MutexWrapper;
+#define SOCKET_ASSERT_OWNER(cond)
+#endif
+
+// 批量接收的udp 数据报, addr 只在回调期间有效
+struct RecvDatagram {
+    Buffer::Ptr buffer;
+    sockaddr* addr;
+    socklen_t addrLen;
+};
+
 // socket对象
 class Socket : public std::enable_shared_from_this<Socket>, public noncopyable, public SocketInfo {
   public:
@@ -138,9 +181,17 @@ class Socket : public std::enable_shared_from_this<Socket>, public noncopyable,
     using onReadCB = std::function<void(const Buffer::Ptr& buf, sockaddr* addr, int addrLen)>;
     using onErrCB = std::function<void(const SocketException& err)>;
     using onAcceptCB = std::function<void(Ptr& sock, std::shared_ptr<void>& complete)>;
+    // accept 之后、创建socket 对象之前调用, 返回false 时直接关闭该连接
+    using onAcceptFilterCB = std::function<bool(const sockaddr* addr, socklen_t addrLen)>;
+    // 批量接管accept 得到的fd(不创建socket 对象), 回调负责fd 的所有权
+    using onAcceptBatchCB = std::function<void(std::vector<AcceptedFd>& fds)>;
+    // 批量接收模式下每批回调一次
+    using onReadBatchCB = std::function<void(std::vector<RecvDatagram>& datagrams)>;
     using onFlushCB = std::function<bool()>;
     using onCreateSocketCB = std::function<Ptr(const EventPoller::Ptr& poller)>;
     using onSendResultCB = std::function<void(const Buffer::Ptr& buffer, bool sendState)>;
+    // 发送缓存越过高/低水位时回调
+    using onSendWatermarkCB = std::function<void()>;
     using asyncConnectCB = std::shared_ptr<std::function<void(int)>>;
 
     Socket(const EventPoller::Ptr poller = nullptr, bool enableMutex = true);
@@ -149,29 +200,99 @@ class Socket : public std::enable_shared_from_this<Socket>, public noncopyable,
     static Ptr createSocket(const EventPoller::Ptr& poller = nullptr, bool enable_mutex = true);
 
     virtual void setOnRead(onReadCB&& readCB);
+    // 设置后批量接收模式下不再逐个回调onRead
+    virtual void setOnReadBatch(onReadBatchCB&& readBatchCB);
     virtual void setOnErr(onErrCB&& errCB);
     virtual void setOnAccept(onAcceptCB&& acceptCB);
+    virtual void setOnAcceptFilter(onAcceptFilterCB&& filterCB);
+    // 设置后onAccept 不再生效, 每轮accept 结束时回调一次
+    virtual void setOnAcceptBatch(onAcceptBatchCB&& batchCB);
     virtual void setOnFlush(onFlushCB&& flushCB);
     virtual void setOnCreateSocket(onCreateSocketCB&& createSocketCB); // onBeforeAccept
     virtual void setOnSendResult(onSendResultCB&& sendResultCB);
+    // 待发送字节数达到高水位时回调, 生产者应暂停发送
+    virtual void setOnSendBlocked(onSendWatermarkCB&& blockedCB);
+    // 阻塞后待发送字节数回落到低水位时回调, 生产者可恢复发送
+    virtual void setOnSendDrained(onSendWatermarkCB&& drainedCB);
 
     // 创建tcp客户端并异步连接服务器
     virtual void connect(const std ::string& url, uint16_t port, const onErrCB& errCB, float timeoutSec = 5, const std::string& localIP = "::", uint16_t localPort = 0);
 
-    // 创建TCP监听服务器；backLog: tcp最大积压数量
-    virtual bool listen(uint16_t port, const std::string& localIP = "::", int backLog = 1024);
+    // 创建TCP监听服务器；backLog: tcp最大积压数量; fastOpenQueue: 大于0 时开启TCP Fast Open
+    virtual bool listen(uint16_t port, const std::string& localIP = "::", int backLog = 1024, int fastOpenQueue = 0);
+
+    // 监听socket 单次事件最多accept 的连接数, 剩余连接下一轮处理, 0 表示不限制
+    void setAcceptBatch(size_t batch);
+
+    // 数据读入poller 的接收slab, 回调中的Buffer 可直接保存或转发, 不会被下次读取覆盖
+    // 默认读入poller 共享的读缓存, 回调返回后即失效
+    void enableRecvSlab(bool enable = true);
+
+    // 单次待发送数据不小于threshold 字节时使用MSG_ZEROCOPY 发送, 缓存在内核完成通知后才释放并回调发送结果
+    // 只对当前已连接的tcp fd 生效, 需在poller 线程调用; 内核持续拷贝时自动回退为普通发送
+    bool enableZeroCopy(size_t threshold = 10 * 1024);
+
+    // udp 使用recvmmsg 批量接收, 缓存从内存池分配, 未被回调保存的缓存下次直接复用
+    // 每批最多maxBatch 个数据报, 批大小随积压情况自适应; slotSize 为单个数据报的最大长度, 超长的数据报被丢弃
+    // maxBatch 为0 时关闭, 最大为UIO_MAXIOV; 批大小另受槽位总大小4MB 限制, 开启UDP_GRO(槽位64KB) 时最多64 个
+    void setRecvBatch(size_t maxBatch, size_t slotSize = 2048);
+
+    // 小于size 字节的相邻发送缓存在flush 时拷贝合并为一项发送, 减少iovec 数量, 0 表示不合并(仅tcp)
+    void setWriteCombine(size_t size);
+
+    // udp 发送时合并连续发往同一地址的等长数据报, 由内核分段发送(UDP_SEGMENT), 内核不支持时返回false
+    bool enableUdpGso(bool enable = true);
+
+    // udp 接收内核合并的数据报(UDP_GRO), 回调前按原数据报拆分; 批量接收模式下槽位扩大到64KB
+    bool enableUdpGro(bool enable = true);
+
+    // 接管一个已accept 的fd 并注册到本socket 的poller, 需在poller 线程调用
+    virtual bool attachPeerFd(int fd, const sockaddr* addr = nullptr, socklen_t addrLen = 0);
 
     // 创建udp套接字（无连接，可作为服务器或客户端）
     virtual bool bindUdpSocket(uint16_t port, const std::string& localIP = "::", bool enableReuse = true);
 
     // 返回 -1 表示失败, ssize_t： long
     ssize_t send(const char* buf, size_t size = 0, sockaddr* addr = nullptr, socklen_t addrLen = 0, bool tryFlush = true);
-    ssize_t send(const std::string buf, sockaddr* addr = nullptr, socklen_t addrLen = 0, bool tryFlush = true);
-    virtual ssize_t send(const Buffer::Ptr buf, sockaddr* addr = nullptr, socklen_t addrLen = 0, bool tryFlush = true);
+    // 右值传入时直接接管string 的内存, 不拷贝
+    ssize_t send(std::string buf, sockaddr* addr = nullptr, socklen_t addrLen = 0, bool tryFlush = true);
+    // 同一个Buffer 可发送给多个socket, 共享同一份数据
+    virtual ssize_t send(Buffer::Ptr buf, sockaddr* addr = nullptr, socklen_t addrLen = 0, bool tryFlush = true);
 
     // 将所有数据写入socket,清除缓存
     int flushAll();
 
+    // 单次读事件最多读取bytes 字节、调用calls 次recv(批量接收模式下为recvmmsg), 超出后剩余数据放到下一轮任务中读取
+    // 避免单个高流量连接独占poller, 0 表示不限制
+    void setReadBudget(size_t bytes, size_t calls = 0);
+
+    // 按最近的读取长度(及读满时FIONREAD 得到的待读长度)调整每次recv 的长度, 小消息不占用整个读缓存(仅tcp)
+    void enableAdaptiveRead(bool enable = true);
+
+    // 收到数据的一轮事件循环内, poller 线程的send 只缓存不发送, 本轮所有事件处理完后统一flush 一次
+    // tcpCork 为true 时期间同时开启TCP_CORK, flush 后关闭(仅tcp)
+    void enableAutoCork(bool enable = true, bool tcpCork = false);
+
+    // 在poller 线程发送且没有待发送数据时直接写入socket, 只缓存未发送的部分(默认开启, 仅tcp)
+    // 部分发送时原缓存入队并从已发送的偏移继续发送, 发送结果回调中的缓存仍为调用方传入的缓存
+    void enableSendDirect(bool enable = true);
+
+    // connect 时开启TCP Fast Open, 连接回调立即触发, 第一次发送的数据随SYN 发出, 省去一个RTT
+    // 没有cookie 或内核不支持时退回普通握手, 需在connect 之前设置(仅tcp 客户端)
+    void enableFastOpen(bool enable = true) {
+        _fastOpen = enable;
+    }
+
+    // 开启后其他线程调用send 时不上锁也不在本线程发送, 数据压入无锁队列后由poller 线程统一写入
+    // 同一socket 在poller 处理前的多次send 只唤醒一次poller; 此时flushAll 同样交给poller 线程执行
+    void enableSendHandoff(bool enable = true);
+
+    // 待发送字节数(等待及发送中)达到high 时触发onSendBlocked, 之后回落到low 时触发onSendDrained
+    // high 为0 时关闭; 水位只用于通知, 超过高水位的数据仍会被缓存
+    void setSendWatermark(size_t high, size_t low = 0);
+    // 代理场景下的上游socket: 本socket 发送阻塞时暂停其接收, 回落到低水位时恢复, 传入空指针解除
+    void setUpstream(const Ptr& upstream);
+
     // 在poller中触发onErrCB,同时关闭socket
     virtual bool emitErr(const SocketException& socketException) noexcept;
 
@@ -204,13 +325,27 @@ class Socket : public std::enable_shared_from_this<Socket>, public noncopyable,
 
     // 获取缓存buffer个数(等待及发送中的数据的个数)
     virtual size_t getSendBufferCount() const;
+    // 获取缓存的字节数(等待及发送中的数据的字节数)
+    virtual size_t getSendBufferBytes() const;
     // 获取上次socket发送缓存清空至今的毫秒数
     virtual uint64_t elapsedTimeAfterFlushed() const;
+    // 获取上次收到数据至今的毫秒数
+    virtual uint64_t elapsedTimeAfterRecv() const;
 
     // 网速, bytes/s
     int getRecvSpeed();
     int getSendSpeed();
 
+    // 读取tcp 连接的TCP_INFO 指标(rtt、拥塞窗口、重传、交付速率等), 非tcp 或未连接时返回false
+    bool getTcpInfo(TcpInfo& info) const;
+    // 缓冲区策略为Adaptive 时按带宽时延积调整tcp 收发缓冲区, 由所属server/client 的管理定时器定期调用
+    void tuneSocketBuf();
+
+    // 收发统计快照, 计数始终开启, 任意线程可调用
+    TrafficStats getStats() const;
+    // 同时累加到server 的计数器(所属poller 的计数器总是累加)
+    void setServerCounters(const TrafficCounters::Ptr& counters);
+
     std::string get_localIP() override;
     uint16_t get_localPort() override;
     std::string get_peerIP() override;
@@ -219,22 +354,66 @@ class Socket : public std::enable_shared_from_this<Socket>, public noncopyable,
 
   private:
     SocketFD::Ptr cloneSocketFd(const Socket& sock);
-    SocketFD::Ptr setPeerSock(int fd);
+    SocketFD::Ptr setPeerSock(int fd, const sockaddr* addr = nullptr, socklen_t addrLen = 0);
     SocketFD::Ptr makeSocketFD(int fd, SocketType type);
     int onAccept(const SocketFD::Ptr& sock, int event) noexcept;
+    void onAcceptPeer(const AcceptedFd& accepted) noexcept;
+    void flushAcceptBatch() noexcept;
     ssize_t onRead(const SocketFD::Ptr& sock, bool isUdp = false) noexcept;
+    ssize_t onReadBatch(const SocketFD::Ptr& sock) noexcept;
+    bool readBudgetExhausted(size_t calls, size_t bytes) const;
+    // 下一轮任务中继续读取
+    void resumeRead(const SocketFD::Ptr& sock);
+    void updateReadSize(const SocketFD::Ptr& sock, size_t nread, size_t readSize);
     void onWriteable(const SocketFD::Ptr& sock);
+    void onError(const SocketFD::Ptr& sock);
     void onConnected(const SocketFD::Ptr& sock, const onErrCB& errcb);
     void onFlush();
     void startWriteableEvent(const SocketFD::Ptr& sock);
     void stopWriteableEvent(const SocketFD::Ptr& sock);
     bool listen(const SocketFD::Ptr& sock);
     bool flushData(const SocketFD::Ptr& sock, bool pollerThread);
+    // 本轮事件循环暂缓发送, 轮末调用uncork
+    void cork(const SocketFD::Ptr& sock);
+    void uncork(bool tcpCork);
+    // 队列为空时直接发送, 返回false 表示需走队列发送
+    bool sendDirect(const Buffer::Ptr& buf);
+    // poller 线程取出其他线程交接的数据并发送
+    void onSendHandoff();
+    // 更新_socketFd, 调用方需持有_mtxSocketFd
+    void setSocketFd(SocketFD::Ptr sock);
+    // 累加本socket、所属poller 及server 的计数
+    void countRecv(size_t bytes, size_t packets, size_t calls);
+    void countSend(size_t bytes, size_t packets, size_t calls);
+    // 待发送字节数减少
+    void onSendBytes(size_t bytes);
+    // 按当前待发送字节数切换阻塞状态并回调
+    void checkSendWatermark();
+    // 在上游socket 的poller 线程中暂停或恢复其接收
+    void pauseUpstream(bool pause);
     bool attachEvent(const SocketFD::Ptr& sock);
 
     int _sockFlags{MSG_NOSIGNAL | MSG_DONTWAIT};
+    size_t _acceptBatch{64};
     std::atomic<bool> _enableRecv{true};
+    std::atomic<bool> _recvSlab{false};
     std::atomic<bool> _sendable{true};
+    // 批量接收配置, 只在poller 线程按配置重建_recvBatch
+    std::atomic<size_t> _combineSize{WRITE_COMBINE_DEFAULT_SIZE};
+    std::atomic<bool> _udpGso{false};
+    std::atomic<bool> _udpGro{false};
+    std::atomic<size_t> _recvBatchMax{0};
+    std::atomic<size_t> _recvBatchSlot{0};
+    // 读取预算, 0 表示不限制
+    std::atomic<size_t> _readBudgetBytes{0};
+    std::atomic<size_t> _readBudgetCalls{0};
+    std::atomic<bool> _adaptiveRead{false};
+    // 以下只在poller 线程访问
+    bool _readResumePending{false};
+    size_t _readSize{READ_SIZE_INIT};
+    size_t _readAvg{0};
+    struct RecvBatch;
+    std::unique_ptr<RecvBatch> _recvBatch;
 
     // tcp连接超时定时器
     Timer::Ptr _conTime;
@@ -242,32 +421,67 @@ class Socket : public std::enable_shared_from_this<Socket>, public noncopyable,
     asyncConnectCB _asyncConnectCB;
     // 缓存清空(flush)计时器
     toolkit::Ticker _sendFlushTicker;
+    // 数据接收计时器
+    toolkit::Ticker _recvTicker;
 
     BufferRaw::Ptr _readBuffer;
     SocketFD::Ptr _socketFd;
+    // accept 时获取的对端地址, ss_family 为AF_UNSPEC 时表示未知
+    sockaddr_storage _peerAddr{AF_UNSPEC};
     EventPoller::Ptr _poller;
     // 读socket文件描述符时上锁（跨线程）
-    mutable MutexWrapper _mtxSocketFd;
+    mutable SocketMutex _mtxSocketFd;
 
     onErrCB _onErrCB;
     onReadCB _onReadCB;
+    onReadBatchCB _onReadBatchCB;
     onFlushCB _onFlushCB;
     onAcceptCB _onAcceptCB;
+    onAcceptFilterCB _onAcceptFilterCB;
+    onAcceptBatchCB _onAcceptBatchCB;
+    std::vector<AcceptedFd> _acceptedFds;
     onCreateSocketCB _onCreateSocketCB;
-    mutable MutexWrapper _mtxEvent;
+    mutable SocketMutex _mtxEvent;
 
     // buffer清空最长超时
     uint32_t _maxSendBufferMs{10 * 1000};
-    std::list<Buffer::Ptr> _sendBufWaiting;
+    BufferList::List _sendBufWaiting;
     std::list<BufferList::Ptr> _sendBufSending;
-    mutable MutexWrapper _mtxSendBufWaiting;
-    mutable MutexWrapper _mtxSendBufSending;
+    IovecCache::Ptr _iovecCache;
+    mutable SocketMutex _mtxSendBufWaiting;
+    mutable SocketMutex _mtxSendBufSending;
     onSendResultCB _onSendResultCB;
+    std::atomic<bool> _sendDirect{true};
+    // _sendBufWaiting 第一个缓存已直接发送的字节数, 受_mtxSendBufWaiting 保护
+    size_t _sendWaitingOffset{0};
+    bool _fastOpen{false};
+    // 自动cork 配置, _corked 只在poller 线程修改
+    std::atomic<bool> _autoCork{false};
+    std::atomic<bool> _tcpCork{false};
+    std::atomic<bool> _corked{false};
+    // 其他线程交接的待发送数据
+    std::atomic<bool> _sendHandoff{false};
+    MpscQueue<Buffer::Ptr> _handoffQueue;
+    // 是否有fd, 供其他线程的handoff 发送无锁判断
+    std::atomic<bool> _hasSocketFd{false};
+    // 发送水位, _sendBlocked 只在_mtxEvent 下修改
+    std::atomic<size_t> _sendBytes{0};
+    std::atomic<size_t> _sendHighWater{0};
+    std::atomic<size_t> _sendLowWater{0};
+    std::atomic<bool> _sendBlocked{false};
+    onSendWatermarkCB _onSendBlockedCB;
+    onSendWatermarkCB _onSendDrainedCB;
+    std::weak_ptr<Socket> _upstream;
     // toolkit::ObjectStatistic<Socket> _statistic;
 
-    bool _enableSpeed{false};
-    toolkit::BytesSpeed _recvSpeed;
-    toolkit::BytesSpeed _sendSpeed;
+    TrafficCounters _counters;
+    TrafficCounters::Ptr _serverCounters;
+    RateMeter _recvSpeed;
+    RateMeter _sendSpeed;
+    // 缓冲区自适应调整用的接收速率及当前设置的大小(0 为未设置)
+    RateMeter _tuneRecvSpeed;
+    int _tunedSendBuf{0};
+    int _tunedRecvBuf{0};
 };
 
 class SocketSender {
@@ -278,11 +492,12 @@ class SocketSender {
     virtual void shutdown(const SocketException& socketException = SocketException(Errcode::Err_shutdown, "shutdown")) = 0;
 
     SocketSender& operator<<(const char* buf);
-    SocketSender& operator<<(const std::string buf);
-    SocketSender& operator<<(const Buffer::Ptr buf);
+    SocketSender& operator<<(std::string buf);
+    SocketSender& operator<<(Buffer::Ptr buf);
 
     ssize_t send(const char* buf, size_t size = 0);
-    ssize_t send(const std::string buf);
+    // 右值传入时不拷贝
+    ssize_t send(std::string buf);
     virtual ssize_t send(Buffer::Ptr buf) = 0;
 };
 
@@ -312,6 +527,7 @@ class SocketHelper : public SocketSender, public SocketInfo, public TaskExecutor
     Task::Ptr async(TaskIn task, bool maySync = true) override;
     Task::Ptr async_first(TaskIn task, bool maySync = true) override;
 
+    using SocketSender::send;
     ssize_t send(Buffer::Ptr buf) override;
     void shutdown(const SocketException& socketException = SocketException(Errcode::Err_shutdown, "shutdown")) override;
 
@@ -6,9 +6,13 @@
 #include "Util/logger.h"
 #include "uv_errno.hpp"
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
 namespace myNet {
 
-int SocketUtil::connect(const char* host, uint16_t port, bool async, const char* localIp, uint16_t localPort) {
+int SocketUtil::connect(const char* host, uint16_t port, bool async, const char* localIp, uint16_t localPort, bool fastOpen) {
     sockaddr_storage addr;
     if (!getDomainIP(host, port, addr, AF_INET, SOCK_STREAM, IPPROTO_TCP)) {
         WarnL << "DNS failed.";
@@ -24,10 +28,13 @@ int SocketUtil::connect(const char* host, uint16_t port, bool async, const char*
     setReuseable(sockfd);
     setNoBlocked(sockfd, async);
     setNoDelay(sockfd);
-    setSendBuf(sockfd);
-    setRecvBuf(sockfd);
+    applyBufPolicy(sockfd, getBufPolicy(), true);
     setCloseWait(sockfd);
     setCloExec(sockfd);
+    if (fastOpen) {
+        // 设置失败时按普通方式连接
+        setFastOpenConnect(sockfd);
+    }
 
     if (-1 == bindSock(sockfd, localIp, localPort, addr.ss_family)) {
         close(sockfd);
@@ -48,7 +55,7 @@ int SocketUtil::connect(const char* host, uint16_t port, bool async, const char*
     return -1;
 }
 
-int SocketUtil::listen(const uint16_t port, const char* localIp, int backLog) {
+int SocketUtil::listen(const uint16_t port, const char* localIp, int backLog, int fastOpenQueue) {
     int sockfd = -1;
     int family = supportIpv6() ? (isIpv4(localIp) ? AF_INET : AF_INET6) : AF_INET6;
     if (-1 == (sockfd = socket(family, SOCK_STREAM, IPPROTO_TCP))) {
@@ -59,6 +66,14 @@ int SocketUtil::listen(const uint16_t port, const char* localIp, int backLog) {
     setReuseable(sockfd, true, false);
     setNoBlocked(sockfd);
     setCloExec(sockfd);
+    // Linux 下accept 得到的socket 会继承监听socket 的这些选项, 在此设置一次即可
+    // 非阻塞和FD_CLOEXEC 不会被继承, 由accept4 设置
+    setNoDelay(sockfd);
+    applyBufPolicy(sockfd, getBufPolicy(), true);
+    setCloseWait(sockfd);
+    if (fastOpenQueue > 0) {
+        setFastOpen(sockfd, fastOpenQueue);
+    }
 
     if (-1 == bindSock(sockfd, localIp, port, family)) {
         close(sockfd);
@@ -74,6 +89,15 @@ int SocketUtil::listen(const uint16_t port, const char* localIp, int backLog) {
     return sockfd;
 }
 
+int SocketUtil::accept(int listenFd, sockaddr_storage& addr, socklen_t& addrLen) {
+    int fd;
+    do {
+        addrLen = sizeof(addr);
+        fd = accept4(listenFd, (sockaddr*)&addr, &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    } while (-1 == fd && UV_EINTR == uv_translate_posix_error(errno));
+    return fd;
+}
+
 int SocketUtil::bindUdpSocket(const uint16_t port, const char* localIp, bool enableReuse) {
     int sockfd = -1;
     int family = supportIpv6() ? (isIpv4(localIp) ? AF_INET : AF_INET6) : AF_INET;
@@ -84,8 +108,7 @@ int SocketUtil::bindUdpSocket(const uint16_t port, const char* localIp, bool ena
 
     if (enableReuse) setReuseable(sockfd);
     setNoBlocked(sockfd);
-    setSendBuf(sockfd);
-    setRecvBuf(sockfd);
+    applyBufPolicy(sockfd, getBufPolicy(), false);
     setCloseWait(sockfd);
     setCloExec(sockfd);
 
@@ -422,6 +445,45 @@ int SocketUtil::setSendBuf(int fd, int size) {
     return 0;
 }
 
+int SocketUtil::getRecvBuf(int fd) {
+    int size = 0;
+    socklen_t len = sizeof(size);
+    if (-1 == getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len)) {
+        TraceL << "getsockopt SO_RCVBUF failed.";
+        return -1;
+    }
+    return size;
+}
+
+static SocketBufPolicy s_bufPolicy;
+
+void SocketUtil::setBufPolicy(const SocketBufPolicy& policy) {
+    s_bufPolicy = policy;
+}
+
+const SocketBufPolicy& SocketUtil::getBufPolicy() {
+    return s_bufPolicy;
+}
+
+void SocketUtil::applyBufPolicy(int fd, const SocketBufPolicy& policy, bool tcp) {
+    // 设置SO_SNDBUF/SO_RCVBUF 后内核不再自动调整该socket 的缓冲区
+    if (policy.mode == SocketBufPolicy::Mode::Fixed || (policy.mode == SocketBufPolicy::Mode::Adaptive && !tcp)) {
+        setSendBuf(fd, policy.size);
+        setRecvBuf(fd, policy.size);
+    }
+    if (tcp && policy.notsentLowat > 0) {
+        setNotsentLowat(fd, policy.notsentLowat);
+    }
+}
+
+int SocketUtil::setNotsentLowat(int fd, int bytes) {
+    if (-1 == setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes, sizeof(bytes))) {
+        TraceL << "setsockopt TCP_NOTSENT_LOWAT failed.";
+        return -1;
+    }
+    return 0;
+}
+
 int SocketUtil::setReuseable(int fd, bool on, bool reusePort) {
     if (-1 == setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (int*)&on, sizeof(int))) {
         TraceL << "setsockopt SO_REUSEADDR failed.";
@@ -506,6 +568,117 @@ int SocketUtil::setCloseWait(int sockfd, int second) {
     return 0;
 }
 
+int SocketUtil::setDeferAccept(int sockfd, int second) {
+    if (-1 == setsockopt(sockfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &second, sizeof(second))) {
+        TraceL << "setsockopt TCP_DEFER_ACCEPT failed.";
+        return -1;
+    }
+    return 0;
+}
+
+namespace {
+// 内核的tcp_info, glibc 的定义只到tcpi_total_retrans, 之后的字段按内核布局补齐
+struct KernelTcpInfo {
+    tcp_info base;
+    uint64_t pacingRate;
+    uint64_t maxPacingRate;
+    uint64_t bytesAcked;
+    uint64_t bytesReceived;
+    uint32_t segsOut;
+    uint32_t segsIn;
+    uint32_t notsentBytes;
+    uint32_t minRtt;
+    uint32_t dataSegsIn;
+    uint32_t dataSegsOut;
+    uint64_t deliveryRate;
+};
+} // namespace
+
+int SocketUtil::getTcpInfo(int sockfd, TcpInfo& info) {
+    KernelTcpInfo kinfo;
+    memset(&kinfo, 0, sizeof(kinfo));
+    socklen_t len = sizeof(kinfo);
+    if (-1 == getsockopt(sockfd, IPPROTO_TCP, TCP_INFO, &kinfo, &len)) {
+        TraceL << "getsockopt TCP_INFO failed.";
+        return -1;
+    }
+    // 旧内核返回的长度较短, 未返回的字段保持为0
+    info.state = kinfo.base.tcpi_state;
+    info.rtt = kinfo.base.tcpi_rtt;
+    info.rttVar = kinfo.base.tcpi_rttvar;
+    info.rcvRtt = kinfo.base.tcpi_rcv_rtt;
+    info.cwnd = kinfo.base.tcpi_snd_cwnd;
+    info.mss = kinfo.base.tcpi_snd_mss;
+    info.unacked = kinfo.base.tcpi_unacked;
+    info.retransmits = kinfo.base.tcpi_total_retrans;
+    info.lost = kinfo.base.tcpi_lost;
+    info.minRtt = kinfo.minRtt;
+    info.notsentBytes = kinfo.notsentBytes;
+    info.deliveryRate = kinfo.deliveryRate;
+    info.bytesAcked = kinfo.bytesAcked;
+
+    // 发送队列中的字节数(未发出 + 未确认)
+    int outq = 0;
+    if (0 == ioctl(sockfd, TIOCOUTQ, &outq) && outq > (int)info.notsentBytes) {
+        info.unackedBytes = outq - info.notsentBytes;
+    } else {
+        info.unackedBytes = 0;
+    }
+    return 0;
+}
+
+int SocketUtil::setFastOpen(int sockfd, int queueLen) {
+    if (-1 == setsockopt(sockfd, IPPROTO_TCP, TCP_FASTOPEN, &queueLen, sizeof(queueLen))) {
+        TraceL << "setsockopt TCP_FASTOPEN failed.";
+        return -1;
+    }
+    return 0;
+}
+
+int SocketUtil::setFastOpenConnect(int sockfd, bool on) {
+    int opt = on ? 1 : 0;
+    if (-1 == setsockopt(sockfd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &opt, sizeof(opt))) {
+        TraceL << "setsockopt TCP_FASTOPEN_CONNECT failed.";
+        return -1;
+    }
+    return 0;
+}
+
+int SocketUtil::setCork(int sockfd, bool on) {
+    int opt = on ? 1 : 0;
+    if (-1 == setsockopt(sockfd, IPPROTO_TCP, TCP_CORK, &opt, sizeof(opt))) {
+        TraceL << "setsockopt TCP_CORK failed.";
+        return -1;
+    }
+    return 0;
+}
+
+int SocketUtil::setZeroCopy(int sockfd, bool on) {
+    int opt = on ? 1 : 0;
+    if (-1 == setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt))) {
+        TraceL << "setsockopt SO_ZEROCOPY failed.";
+        return -1;
+    }
+    return 0;
+}
+
+int SocketUtil::setUdpSegment(int sockfd, int size) {
+    if (-1 == setsockopt(sockfd, SOL_UDP, UDP_SEGMENT, &size, sizeof(size))) {
+        TraceL << "setsockopt UDP_SEGMENT failed.";
+        return -1;
+    }
+    return 0;
+}
+
+int SocketUtil::setUdpGro(int sockfd, bool on) {
+    int opt = on ? 1 : 0;
+    if (-1 == setsockopt(sockfd, SOL_UDP, UDP_GRO, &opt, sizeof(opt))) {
+        TraceL << "setsockopt UDP_GRO failed.";
+        return -1;
+    }
+    return 0;
+}
+
 int SocketUtil::bindSock(int sockfd, const char* NICIp, uint16_t port, int family) {
     switch (family) {
     case AF_INET:
@@ -6,6 +6,7 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 
@@ -25,13 +26,77 @@ namespace myNet {
 #define TCP_KEEPALIVE_PROBE_TIMES 9
 #define TCP_KEEPALIVE_TIME 120
 
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT 30
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// TCP_INFO 中常用的连接指标, 内核不支持的字段为0
+struct TcpInfo {
+    uint8_t state{0};
+    // 平滑RTT 及其偏差, 微秒
+    uint32_t rtt{0};
+    uint32_t rttVar{0};
+    uint32_t minRtt{0};
+    // 接收方向估计的RTT, 微秒
+    uint32_t rcvRtt{0};
+    // 拥塞窗口, 报文段数
+    uint32_t cwnd{0};
+    uint32_t mss{0};
+    // 已发出未确认的报文段数及字节数
+    uint32_t unacked{0};
+    uint32_t unackedBytes{0};
+    // 已写入但未发出的字节数
+    uint32_t notsentBytes{0};
+    // 累计重传的报文段数
+    uint32_t retransmits{0};
+    uint32_t lost{0};
+    // 最近的交付速率, bytes/s
+    uint64_t deliveryRate{0};
+    uint64_t bytesAcked{0};
+};
+
+// socket 收发缓冲区策略
+struct SocketBufPolicy {
+    enum class Mode {
+        // 不设置SO_SNDBUF/SO_RCVBUF, 由内核自动调整
+        Kernel,
+        // 固定为size
+        Fixed,
+        // tcp 按TCP_INFO 测得的带宽时延积定期调整, 限制在[minSize, maxSize], 首次调整前由内核自动调整; udp 同Fixed
+        Adaptive,
+    };
+
+    Mode mode{Mode::Fixed};
+    int size{SOCKET_DEFAULT_BUF_SIZE};
+    int minSize{16 * 1024};
+    int maxSize{4 * 1024 * 1024};
+    // TCP_NOTSENT_LOWAT, 未发出的字节数低于该值时才触发可写事件, 0 为不设置
+    int notsentLowat{0};
+};
+
 class SocketUtil {
   public:
     // 创建tcp客户端套接字并连接服务器
-    static int connect(const char* host, uint16_t port, bool async = true, const char* localIp = "::", uint16_t localPort = 0);
+    // fastOpen: 开启TCP_FASTOPEN_CONNECT, connect 立即返回, 首次发送的数据随SYN 发出, 没有cookie 时内核自动退回普通握手
+    static int connect(const char* host, uint16_t port, bool async = true, const char* localIp = "::", uint16_t localPort = 0, bool fastOpen = false);
 
     // 创建tcp监听套接字
-    static int listen(const uint16_t port, const char* localIp = "::", int backLog = 1024);
+    // fastOpenQueue: 大于0 时开启TCP_FASTOPEN, 为尚未完成握手的fast open 连接队列长度(需net.ipv4.tcp_fastopen 开启服务端位)
+    static int listen(const uint16_t port, const char* localIp = "::", int backLog = 1024, int fastOpenQueue = 0);
+
+    // accept4 接收连接, 新fd 直接为非阻塞且带FD_CLOEXEC, 同时获取对端地址
+    static int accept(int listenFd, sockaddr_storage& addr, socklen_t& addrLen);
 
     // 创建udp套接字
     static int bindUdpSocket(const uint16_t port, const char* localIp = "::", bool enableReuse = true);
@@ -120,6 +185,18 @@ class SocketUtil {
 
     // 设置发送缓存大小
     static int setSendBuf(int fd, int size = SOCKET_DEFAULT_BUF_SIZE);
+    // 获取SO_RCVBUF 的当前值(内核为设置值的2倍), 失败时返回-1
+    static int getRecvBuf(int fd);
+
+    // 新建socket 使用的缓冲区策略, 需在创建socket 之前设置
+    static void setBufPolicy(const SocketBufPolicy& policy);
+    static const SocketBufPolicy& getBufPolicy();
+
+    // 按策略设置收发缓冲区及TCP_NOTSENT_LOWAT(仅tcp)
+    static void applyBufPolicy(int fd, const SocketBufPolicy& policy, bool tcp);
+
+    // TCP_NOTSENT_LOWAT 特性, 未发出的数据低于该值时socket 才可写
+    static int setNotsentLowat(int fd, int bytes);
 
     // 地址复用和端口复用: https://cloud.tencent.com/developer/article/1968846
     // https://cloud.tencent.com/developer/article/1844163
@@ -143,6 +220,30 @@ class SocketUtil {
     // SO_LINGER选项用来设置延迟关闭的时间，等待套接字发送缓冲区中的数据发送完成。 https://www.cnblogs.com/kex1n/p/7401042.html
     static int setCloseWait(int sockfd, int second = 0);
 
+    // TCP_DEFER_ACCEPT 特性, 连接收到首个数据包(或超时)后才能被accept
+    static int setDeferAccept(int sockfd, int second = 1);
+
+    // 读取TCP_INFO(linux 4.9+ 才有交付速率等字段), 并通过TIOCOUTQ 计算未确认的字节数
+    static int getTcpInfo(int sockfd, TcpInfo& info);
+
+    // TCP_FASTOPEN 特性, 用于监听socket
+    static int setFastOpen(int sockfd, int queueLen = 256);
+
+    // TCP_FASTOPEN_CONNECT 特性, 需在connect 之前设置(linux 4.11+)
+    static int setFastOpenConnect(int sockfd, bool on = true);
+
+    // TCP_CORK 特性, 开启时不发送未满的报文段, 关闭时立即发出
+    static int setCork(int sockfd, bool on = true);
+
+    // SO_ZEROCOPY 特性, 允许使用MSG_ZEROCOPY 发送(linux 4.14+)
+    static int setZeroCopy(int sockfd, bool on = true);
+
+    // UDP_SEGMENT 特性, 设置默认的分段卸载长度, 0 表示不分段, 也可用于检测内核是否支持(linux 4.18+)
+    static int setUdpSegment(int sockfd, int size = 0);
+
+    // UDP_GRO 特性, 允许接收内核合并后的多个数据报(linux 5.0+)
+    static int setUdpGro(int sockfd, bool on = true);
+
     /* 组播特性，暂时不实现
 
     // 设置组播ttl
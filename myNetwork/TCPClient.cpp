@@ -16,10 +16,14 @@ void TCPClient::connect(const std::string& url, uint16_t port, float timeoutSec,
         }
 
         sharedThis->onManager();
+        if (auto& sock = sharedThis->getSocket()) {
+            sock->tuneSocketBuf();
+        }
         return true;
     });
 
     setSock(createSocket());
+    getSocket()->enableFastOpen(_fastOpen);
 
     // 原代码写得比较奇怪，SocketHelper 只有在setSock 时改变sock
     // 并且只有SocketHelper 的构造函数调用setSock，这么写应该不会出问题
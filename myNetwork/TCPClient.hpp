@@ -30,6 +30,11 @@ class TCPClient : public std::enable_shared_from_this<TCPClient>, public SocketH
         _netAdapter = localIp;
     }
 
+    // 开启TCP Fast Open, 连接后立即回调onConnect, onConnect 中发送的首个请求随SYN 发出, 需在connect 之前设置
+    void enableFastOpen(bool enable = true) {
+        _fastOpen = enable;
+    }
+
   protected:
     // 连接成功与否
     virtual void onConnect(const SocketException& e) {
@@ -58,6 +63,7 @@ class TCPClient : public std::enable_shared_from_this<TCPClient>, public SocketH
     void onSocketConnect(const SocketException& e);
 
     std::string _netAdapter{"::"};
+    bool _fastOpen{false};
     std::shared_ptr<Timer> _timer;
 };
 
@@ -3,7 +3,43 @@
 namespace myNet {
 TCPServer::TCPServer(const EventPoller::Ptr& poller) : Server(poller) {
     setOnCreateSocket(nullptr);
-    _socket = _onCreateSocket(poller);
+    initListenSocket();
+}
+
+TCPServer::~TCPServer() {
+    if (!_parent && _socket->getFd() != -1) {
+        InfoL << "Close tcp server [" << _socket->get_localIP() << "]: " << _socket->get_localPort();
+    }
+    _timer.reset();
+    _socket.reset();
+    _sessionMap.clear();
+    _acceptTargets.clear();
+    _clonedServer.clear();
+
+    // 关闭还未来得及创建会话的连接
+    AcceptedFd accepted;
+    while (_acceptRing.pop(accepted)) {
+        close(accepted.fd);
+    }
+}
+
+void TCPServer::setAcceptMode(AcceptMode mode) {
+    if (_acceptMode == mode) {
+        return;
+    }
+    _acceptMode = mode;
+    initListenSocket();
+}
+
+void TCPServer::initListenSocket() {
+    if (_acceptMode == AcceptMode::Acceptor) {
+        // 监听socket 放到专用accept 线程, 只负责accept, 不创建socket 对象
+        // accept 线程上的回调需捕获weak_ptr, 构造函数中无法获取, 在cloneServers 中设置
+        _socket = _onCreateSocket(AcceptorPollerPool::Instance().getPoller());
+        return;
+    }
+
+    _socket = _onCreateSocket(_poller);
     // accept 之前，创建socket
     _socket->setOnCreateSocket([this](const EventPoller::Ptr& poller) {
         // 这个地方会报错，先注释掉
@@ -15,16 +51,50 @@ TCPServer::TCPServer(const EventPoller::Ptr& poller) : Server(poller) {
         auto server = getServer(sockPoller);
         sockPoller->async([server, sock, complete]() { server->onAcceptConnection(sock); });
     });
+    _socket->setOnAcceptFilter([this](const sockaddr* addr, socklen_t addrLen) { return onAdmission(); });
 }
 
-TCPServer::~TCPServer() {
-    if (!_parent && _socket->getFd() != -1) {
-        InfoL << "Close tcp server [" << _socket->get_localIP() << "]: " << _socket->get_localPort();
+void TCPServer::cloneServers() {
+    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr& excutor) {
+        EventPoller::Ptr poller = std::dynamic_pointer_cast<EventPoller>(excutor);
+        if (poller == _poller || !poller) return;
+        auto& ref = _clonedServer[poller.get()];
+        if (!ref) {
+            ref = std::make_shared<TCPServer>(poller);
+        }
+        if (ref) {
+            ref->cloneFrom(*this);
+        }
+    });
+
+    if (_acceptMode == AcceptMode::Acceptor) {
+        // server 可能在其他线程析构, accept 线程上的回调不能直接使用this
+        std::weak_ptr<TCPServer> weakThis = std::static_pointer_cast<TCPServer>(shared_from_this());
+        _socket->setOnAcceptBatch([weakThis](std::vector<AcceptedFd>& fds) {
+            auto strongThis = weakThis.lock();
+            if (!strongThis) {
+                for (auto& accepted : fds) {
+                    close(accepted.fd);
+                }
+                return;
+            }
+            strongThis->onAcceptBatch(fds);
+        });
+        _socket->setOnAcceptFilter([weakThis](const sockaddr* addr, socklen_t addrLen) {
+            auto strongThis = weakThis.lock();
+            return strongThis && strongThis->onAdmission();
+        });
+
+        _acceptTargets.clear();
+        EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr& excutor) {
+            EventPoller::Ptr poller = std::dynamic_pointer_cast<EventPoller>(excutor);
+            if (!poller) return;
+            AcceptTarget target;
+            target.poller = poller;
+            target.server = getServer(poller.get());
+            _acceptTargets.emplace_back(std::move(target));
+        });
     }
-    _timer.reset();
-    _socket.reset();
-    _sessionMap.clear();
-    _clonedServer.clear();
 }
 
 void TCPServer::setOnCreateSocket(Socket::onCreateSocketCB cb) {
@@ -44,7 +114,14 @@ void TCPServer::cloneFrom(const TCPServer& that) {
     }
     _onCreateSocket = that._onCreateSocket;
     _sessionBuilder = that._sessionBuilder;
-    _socket->cloneFromListenSocket(*(that._socket));
+    _admission = that._admission;
+    _acceptMode = that._acceptMode;
+    _counters = that._counters;
+    _tcpInfoSampling = that._tcpInfoSampling;
+    // 专用accept 线程模式下由accept 线程分发fd, 无需克隆监听socket
+    if (_acceptMode == AcceptMode::Cloned) {
+        _socket->cloneFromListenSocket(*(that._socket));
+    }
 
     std::weak_ptr<TCPServer> weakThis = std::dynamic_pointer_cast<TCPServer>(shared_from_this());
     _timer = std::make_shared<Timer>(2.0f, _poller, [weakThis]() -> bool {
@@ -66,11 +143,13 @@ Session::Ptr TCPServer::onAcceptConnection(const Socket::Ptr& sock) {
     assert(_poller->isCurrentThread());
     std::weak_ptr<TCPServer> weakThis = std::dynamic_pointer_cast<TCPServer>(shared_from_this());
 
+    sock->setServerCounters(getCounters(_poller.get()));
     auto sessionHelper = _sessionBuilder(std::dynamic_pointer_cast<TCPServer>(shared_from_this()), sock);
     auto session = sessionHelper->getSession();
     session->attachServer(*this);
 
     assert(true == _sessionMap.emplace(sessionHelper.get(), sessionHelper).second);
+    if (_admission) _admission->onSessionCreated();
 
     std::weak_ptr<Session> weakSession = session;
 
@@ -80,7 +159,12 @@ Session::Ptr TCPServer::onAcceptConnection(const Socket::Ptr& sock) {
             return;
         }
         try {
-            strongSession->onRecv(buf);
+            if (auto& chain = strongSession->getRecvChain()) {
+                chain->append(buf);
+                strongSession->onRecvChain(*chain);
+            } else {
+                strongSession->onRecv(buf);
+            }
         } catch (SocketException& e) {
             strongSession->shutdown(e);
         } catch (std::exception& e) {
@@ -99,7 +183,7 @@ Session::Ptr TCPServer::onAcceptConnection(const Socket::Ptr& sock) {
             assert(strongThis->_poller->isCurrentThread());
             // 管理时需在map 中遍历，不能直接删除
             if (strongThis->_isOnManager) {
-                strongThis->_sessionMap.erase(helperPtr);
+                strongThis->removeSession(helperPtr);
             } else {
                 strongThis->_poller->async(
                     [weakThis, helperPtr]() {
@@ -107,7 +191,7 @@ Session::Ptr TCPServer::onAcceptConnection(const Socket::Ptr& sock) {
                         if (!strongThis) {
                             return;
                         }
-                        strongThis->_sessionMap.erase(helperPtr);
+                        strongThis->removeSession(helperPtr);
                     },
                     false);
             }
@@ -122,19 +206,272 @@ Session::Ptr TCPServer::onAcceptConnection(const Socket::Ptr& sock) {
     return session;
 }
 
+void TCPServer::onAcceptBatch(std::vector<AcceptedFd>& fds) {
+    if (_acceptTargets.empty()) {
+        for (auto& accepted : fds) {
+            close(accepted.fd);
+        }
+        return;
+    }
+
+    // 每批次刷新一次负载, 按负载加本批次已分配数选择目标, 负载相同时轮流分配
+    for (auto& target : _acceptTargets) {
+        target.weight = target.poller->getCachedLoad();
+        target.touched = false;
+    }
+    auto size = _acceptTargets.size();
+    for (auto& accepted : fds) {
+        size_t pos = _acceptCursor;
+        for (size_t i = 1; i < size; ++i) {
+            auto next = (_acceptCursor + i) % size;
+            if (_acceptTargets[next].weight < _acceptTargets[pos].weight) {
+                pos = next;
+            }
+        }
+        _acceptCursor = (pos + 1) % size;
+
+        auto& target = _acceptTargets[pos];
+        ++target.weight;
+        auto server = target.server.lock();
+        if (!server) {
+            close(accepted.fd);
+            continue;
+        }
+        if (!server->_acceptRing.push(accepted)) {
+            // 队列已满, 退化为单独投递
+            target.poller->async([server, accepted]() { server->onAcceptFd(accepted); }, false);
+            continue;
+        }
+        target.touched = true;
+    }
+
+    // 每个poller 每批次最多唤醒一次, 对方尚未处理上次唤醒时不重复投递
+    for (auto& target : _acceptTargets) {
+        auto server = target.server.lock();
+        if (!target.touched || !server || server->_acceptWakeup.exchange(true)) {
+            continue;
+        }
+        std::weak_ptr<TCPServer> weakServer = server;
+        target.poller->async(
+            [weakServer]() {
+                auto strongServer = weakServer.lock();
+                if (strongServer) {
+                    strongServer->onAcceptRing();
+                }
+            },
+            false);
+    }
+}
+
+void TCPServer::onAcceptRing() {
+    assert(_poller->isCurrentThread());
+    // 先清除唤醒标记再取队列, 之后入队的fd 会触发新的唤醒
+    _acceptWakeup.exchange(false);
+    AcceptedFd accepted;
+    while (_acceptRing.pop(accepted)) {
+        onAcceptFd(accepted);
+    }
+}
+
+void TCPServer::onAcceptFd(const AcceptedFd& accepted) {
+    assert(_poller->isCurrentThread());
+    Socket::Ptr sock;
+    try {
+        sock = _onCreateSocket(_poller);
+    } catch (std::exception& e) {
+        ErrorL << "Exception occurred when create socket: " << e.what();
+    }
+    if (!sock) {
+        sock = Socket::createSocket(_poller, false);
+    }
+    if (!sock->attachPeerFd(accepted.fd, (sockaddr*)&accepted.addr, accepted.addrLen)) {
+        return;
+    }
+    onAcceptConnection(sock);
+}
+
 void TCPServer::onManagerSession() {
     assert(_poller->isCurrentThread());
 
     _isOnManager = true;
     std::shared_ptr<void> deleter(nullptr, [this](void*) { _isOnManager = false; });
 
+    bool tuneBuf = SocketUtil::getBufPolicy().mode == SocketBufPolicy::Mode::Adaptive;
     for (auto& [_, session] : _sessionMap) {
         try {
             session->getSession()->onManager();
         } catch (std::exception& e) {
             WarnL << e.what();
         }
+        if (tuneBuf) {
+            auto& sock = session->getSession()->getSocket();
+            if (sock) sock->tuneSocketBuf();
+        }
     };
+
+    if (_tcpInfoSampling) {
+        sampleTcpInfo();
+    }
+}
+
+void TCPServer::sampleTcpInfo() {
+    TcpInfoHistogram histogram;
+    TcpInfo info;
+    for (auto& [_, session] : _sessionMap) {
+        auto& sock = session->getSession()->getSocket();
+        if (sock && sock->getTcpInfo(info)) {
+            histogram.add(info);
+        }
+    }
+    std::lock_guard<std::mutex> lck(_tcpInfoMtx);
+    _tcpInfoHistogram = histogram;
+}
+
+TcpInfoHistogram TCPServer::getTcpInfoHistogram() const {
+    TcpInfoHistogram ret;
+    {
+        std::lock_guard<std::mutex> lck(_tcpInfoMtx);
+        ret = _tcpInfoHistogram;
+    }
+    for (auto& [_, server] : _clonedServer) {
+        std::lock_guard<std::mutex> lck(server->_tcpInfoMtx);
+        ret += server->_tcpInfoHistogram;
+    }
+    return ret;
+}
+
+static size_t bucketOf(uint64_t value) {
+    size_t bucket = 0;
+    while (value && bucket < TcpInfoHistogram::BUCKETS - 1) {
+        value >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void TcpInfoHistogram::add(const TcpInfo& info) {
+    ++connections;
+    ++rtt[bucketOf(info.rtt)];
+    ++cwnd[bucketOf(info.cwnd)];
+    ++retransmits[bucketOf(info.retransmits)];
+    ++deliveryRate[bucketOf(info.deliveryRate)];
+    ++unackedBytes[bucketOf(info.unackedBytes)];
+}
+
+TcpInfoHistogram& TcpInfoHistogram::operator+=(const TcpInfoHistogram& that) {
+    connections += that.connections;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        rtt[i] += that.rtt[i];
+        cwnd[i] += that.cwnd[i];
+        retransmits[i] += that.retransmits[i];
+        deliveryRate[i] += that.deliveryRate[i];
+        unackedBytes[i] += that.unackedBytes[i];
+    }
+    return *this;
+}
+
+uint64_t TcpInfoHistogram::percentile(const uint64_t (&buckets)[BUCKETS], double p) {
+    uint64_t total = 0;
+    for (auto count : buckets) total += count;
+    if (!total) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(p * total), seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen > rank || seen == total) {
+            return i ? ((uint64_t)1 << i) - 1 : 0;
+        }
+    }
+    return 0;
+}
+
+bool TCPServer::onAdmission() {
+    if (!_admission) {
+        return true;
+    }
+    auto verdict = _admission->check();
+    if (verdict == AdmissionControl::Verdict::Accept) {
+        return true;
+    }
+
+    auto& config = _admission->getConfig();
+    switch (config.policy) {
+    case AdmissionControl::ShedPolicy::EvictIdle:
+        // 淘汰空闲会话只能腾出会话数, 限速和过载时仍然拒绝
+        if (verdict != AdmissionControl::Verdict::MaxSessions) {
+            break;
+        }
+        if (_poller->isCurrentThread()) {
+            if (evictIdleSession()) {
+                return true;
+            }
+            break;
+        }
+        // 专用accept 线程中不能访问会话, 本次仍拒绝, 异步淘汰后为后续连接腾出位置
+        {
+            auto poller = EventPollerPool::Instance().getPoller(false);
+            auto server = getServer(poller.get());
+            poller->async([server]() { server->evictIdleSession(); }, false);
+        }
+        break;
+    case AdmissionControl::ShedPolicy::PauseAccept:
+        pauseAccept(config.pauseMs);
+        break;
+    default:
+        break;
+    }
+    _admission->onRejected();
+    return false;
+}
+
+bool TCPServer::evictIdleSession() {
+    assert(_poller->isCurrentThread());
+    SessionHelper* victim{nullptr};
+    uint64_t maxIdle = _admission->getConfig().minIdleMs;
+    for (auto& [helperPtr, helper] : _sessionMap) {
+        auto& sock = helper->getSession()->getSocket();
+        // fd 为-1 说明已在关闭中
+        if (!sock || sock->getFd() == -1) {
+            continue;
+        }
+        auto idle = sock->elapsedTimeAfterRecv();
+        if (idle >= maxIdle) {
+            maxIdle = idle;
+            victim = helperPtr;
+        }
+    }
+    if (!victim) {
+        return false;
+    }
+    victim->getSession()->shutdown(SocketException(Errcode::Err_shutdown, "Evicted by admission control."));
+    return true;
+}
+
+void TCPServer::pauseAccept(uint32_t ms) {
+    if (_acceptPaused) {
+        return;
+    }
+    _acceptPaused = true;
+    _socket->enableRecv(false);
+    WarnL << "Server overload, pause accept for " << ms << "ms";
+
+    // 在监听socket 所在线程恢复, 专用accept 线程模式下与_poller 不同
+    std::weak_ptr<TCPServer> weakThis = std::dynamic_pointer_cast<TCPServer>(shared_from_this());
+    _socket->getPoller()->doDelayTask(ms, [weakThis]() -> uint64_t {
+        auto strongThis = weakThis.lock();
+        if (strongThis) {
+            strongThis->_acceptPaused = false;
+            strongThis->_socket->enableRecv(true);
+        }
+        return 0;
+    });
+}
+
+void TCPServer::removeSession(SessionHelper* helperPtr) {
+    if (_sessionMap.erase(helperPtr) && _admission) {
+        _admission->onSessionClosed();
+    }
 }
 
 TCPServer::Ptr TCPServer::getServer(const EventPoller* poller) const {
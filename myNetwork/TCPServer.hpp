@@ -3,15 +3,46 @@
 
 // #include "Poller/Timer.h"
 #include "../myPoller/EventPollerApp.hpp"
+#include "../myThread/SpscQueue.hpp"
+#include "AdmissionControl.hpp"
 #include "Server.hpp"
+#include "SocketUtil.hpp"
 #include "uv_errno.hpp"
 
 namespace myNet {
 
+// 一次采样中各连接TCP_INFO 指标的分布, 按2 的幂分桶, 第i(i>0) 个桶为[2^(i-1), 2^i), 第0 个桶为0
+struct TcpInfoHistogram {
+    static constexpr size_t BUCKETS = 40;
+
+    size_t connections{0};
+    // 微秒
+    uint64_t rtt[BUCKETS]{};
+    // 报文段数
+    uint64_t cwnd[BUCKETS]{};
+    uint64_t retransmits[BUCKETS]{};
+    // bytes/s
+    uint64_t deliveryRate[BUCKETS]{};
+    uint64_t unackedBytes[BUCKETS]{};
+
+    void add(const TcpInfo& info);
+    TcpInfoHistogram& operator+=(const TcpInfoHistogram& that);
+
+    // 分位数(0~1)所在桶的上界, 没有数据时返回0
+    static uint64_t percentile(const uint64_t (&buckets)[BUCKETS], double p);
+};
+
 class TCPServer : public Server {
   public:
     using Ptr = std::shared_ptr<TCPServer>;
 
+    enum class AcceptMode {
+        // 每个poller 克隆监听socket, 各自accept
+        Cloned,
+        // 专用accept 线程批量accept, 通过无锁队列把fd 分发给各poller
+        Acceptor
+    };
+
     explicit TCPServer(const EventPoller::Ptr& poller = nullptr);
     ~TCPServer() override;
 
@@ -28,24 +59,104 @@ class TCPServer : public Server {
 
     void setOnCreateSocket(Socket::onCreateSocketCB cb);
 
+    // 连接准入控制(会话数上限/限速/过载保护), 需在start 之前设置
+    void setAdmission(const AdmissionControl::Config& config) {
+        _admission = std::make_shared<AdmissionControl>(config);
+    }
+
+    const AdmissionControl::Ptr& getAdmission() const {
+        return _admission;
+    }
+
+    // 开启TCP_DEFER_ACCEPT, 连接收到首个数据后才创建Session, 需在start 之前设置
+    void setDeferAccept(int second) {
+        _deferAcceptSec = second;
+    }
+
+    // 开启TCP Fast Open, 客户端可在SYN 中携带首个请求, queueLen 为未完成握手的fast open 连接上限, 需在start 之前设置
+    // 还需系统开启服务端支持: sysctl net.ipv4.tcp_fastopen=3
+    void setFastOpen(int queueLen = 256) {
+        _fastOpenQueue = queueLen;
+    }
+
+    // 设置accept 模式, 需在start 之前设置
+    void setAcceptMode(AcceptMode mode);
+
+    // 在各poller 的管理定时器中采样所有连接的TCP_INFO, 需在start 之前设置
+    void enableTcpInfoSampling(bool enable = true) {
+        _tcpInfoSampling = enable;
+    }
+
+    // 最近一次采样的分布, 汇总各poller 上的克隆, 任意线程可调用
+    TcpInfoHistogram getTcpInfoHistogram() const;
+
   protected:
     virtual void cloneFrom(const TCPServer& that);
 
     virtual Session::Ptr onAcceptConnection(const Socket::Ptr& sock);
 
   private:
+    struct AcceptTarget {
+        EventPoller::Ptr poller;
+        // 包含自身, 用weak_ptr 避免循环引用
+        std::weak_ptr<TCPServer> server;
+        int weight{0};
+        bool touched{false};
+    };
+
+    void initListenSocket();
+
+    void cloneServers();
+
+    // accept 线程调用, 将一批fd 分发到各poller
+    void onAcceptBatch(std::vector<AcceptedFd>& fds);
+
+    // 本poller 线程调用, 取出队列中的fd 并创建会话
+    void onAcceptRing();
+
+    void onAcceptFd(const AcceptedFd& accepted);
+
     void onManagerSession();
 
+    void sampleTcpInfo();
+
+    // 准入检查, 返回false 时丢弃该连接
+    bool onAdmission();
+
+    // 淘汰本线程最久未收到数据的会话
+    bool evictIdleSession();
+
+    // 暂停监听ms 毫秒
+    void pauseAccept(uint32_t ms);
+
+    void removeSession(SessionHelper* helperPtr);
+
     TCPServer::Ptr getServer(const EventPoller*) const;
 
     bool _isOnManager{false};
+    bool _acceptPaused{false};
+    bool _tcpInfoSampling{false};
+    int _deferAcceptSec{0};
+    int _fastOpenQueue{0};
+    AcceptMode _acceptMode{AcceptMode::Cloned};
     const TCPServer* _parent{nullptr};
     Socket::Ptr _socket;
     std::shared_ptr<Timer> _timer;
+    AdmissionControl::Ptr _admission;
     Socket::onCreateSocketCB _onCreateSocket;
     std::unordered_map<SessionHelper*, SessionHelper::Ptr> _sessionMap;
     std::function<SessionHelper::Ptr(const TCPServer::Ptr&, const Socket::Ptr&)> _sessionBuilder;
     std::unordered_map<const EventPoller*, Ptr> _clonedServer;
+    // 本poller 最近一次的TCP_INFO 采样
+    mutable std::mutex _tcpInfoMtx;
+    TcpInfoHistogram _tcpInfoHistogram;
+
+    // accept 线程生产, 本poller 线程消费
+    SpscQueue<AcceptedFd> _acceptRing;
+    std::atomic<bool> _acceptWakeup{false};
+    // 以下仅在accept 线程访问
+    size_t _acceptCursor{0};
+    std::vector<AcceptTarget> _acceptTargets;
 };
 
 template <typename SessionType> inline void TCPServer::start(uint16_t port, const std::string& host, uint32_t backlog) {
@@ -55,10 +166,18 @@ template <typename SessionType> inline void TCPServer::start(uint16_t port, cons
         return std::make_shared<SessionHelper>(server, session);
     };
 
-    if (!_socket->listen(port, host.c_str(), backlog)) {
+    // 专用accept 线程模式下, 监听前先克隆好各poller 上的server, 避免accept 线程与此处并发访问_clonedServer
+    if (_acceptMode == AcceptMode::Acceptor) {
+        cloneServers();
+    }
+
+    if (!_socket->listen(port, host.c_str(), backlog, _fastOpenQueue)) {
         std::string err = (StrPrinter << "Listen on " << host << " " << port << " failed: " << uv_strerror(uv_translate_posix_error(errno)));
         throw std::runtime_error(err);
     }
+    if (_deferAcceptSec > 0) {
+        SocketUtil::setDeferAccept(_socket->getFd(), _deferAcceptSec);
+    }
 
     std::weak_ptr<TCPServer> weakThis = std::dynamic_pointer_cast<TCPServer>(shared_from_this());
     _timer = std::make_shared<Timer>(2.0f, _poller, [weakThis]() -> bool {
@@ -68,17 +187,9 @@ template <typename SessionType> inline void TCPServer::start(uint16_t port, cons
         return true;
     });
 
-    EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr& excutor) {
-        EventPoller::Ptr poller = std::dynamic_pointer_cast<EventPoller>(excutor);
-        if (poller == _poller || !poller) return;
-        auto& ref = _clonedServer[poller.get()];
-        if (!ref) {
-            ref = std::make_shared<TCPServer>(poller);
-        }
-        if (ref) {
-            ref->cloneFrom(*this);
-        }
-    });
+    if (_acceptMode == AcceptMode::Cloned) {
+        cloneServers();
+    }
 
     InfoL << "TCP server listening on [" << host << "]: " << port;
 }
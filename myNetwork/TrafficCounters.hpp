@@ -0,0 +1,105 @@
+#ifndef TrafficCounters_hpp
+#define TrafficCounters_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace myNet {
+
+// 收发统计快照
+struct TrafficStats {
+    uint64_t recvBytes{0};
+    // 回调给上层的数据块(udp 为数据报)个数
+    uint64_t recvPackets{0};
+    // 接收系统调用次数
+    uint64_t recvCalls{0};
+    uint64_t sendBytes{0};
+    // 发送完成的缓存(udp 为消息)个数
+    uint64_t sendPackets{0};
+    // 发送系统调用次数
+    uint64_t sendCalls{0};
+
+    TrafficStats& operator+=(const TrafficStats& that) {
+        recvBytes += that.recvBytes;
+        recvPackets += that.recvPackets;
+        recvCalls += that.recvCalls;
+        sendBytes += that.sendBytes;
+        sendPackets += that.sendPackets;
+        sendCalls += that.sendCalls;
+        return *this;
+    }
+};
+
+// 收发计数器, relaxed 原子累加, 任意线程可随时读取快照
+// 独占缓存行, 避免与所属对象的其他成员伪共享
+class alignas(64) TrafficCounters {
+  public:
+    using Ptr = std::shared_ptr<TrafficCounters>;
+
+    void addRecv(uint64_t bytes, uint64_t packets, uint64_t calls) {
+        _recvBytes.fetch_add(bytes, std::memory_order_relaxed);
+        _recvPackets.fetch_add(packets, std::memory_order_relaxed);
+        _recvCalls.fetch_add(calls, std::memory_order_relaxed);
+    }
+
+    void addSend(uint64_t bytes, uint64_t packets, uint64_t calls) {
+        _sendBytes.fetch_add(bytes, std::memory_order_relaxed);
+        _sendPackets.fetch_add(packets, std::memory_order_relaxed);
+        _sendCalls.fetch_add(calls, std::memory_order_relaxed);
+    }
+
+    uint64_t getRecvBytes() const {
+        return _recvBytes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getSendBytes() const {
+        return _sendBytes.load(std::memory_order_relaxed);
+    }
+
+    // 各项分别读取, 彼此之间不保证是同一时刻的值
+    TrafficStats snapshot() const {
+        TrafficStats stats;
+        stats.recvBytes = _recvBytes.load(std::memory_order_relaxed);
+        stats.recvPackets = _recvPackets.load(std::memory_order_relaxed);
+        stats.recvCalls = _recvCalls.load(std::memory_order_relaxed);
+        stats.sendBytes = _sendBytes.load(std::memory_order_relaxed);
+        stats.sendPackets = _sendPackets.load(std::memory_order_relaxed);
+        stats.sendCalls = _sendCalls.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+  private:
+    std::atomic<uint64_t> _recvBytes{0};
+    std::atomic<uint64_t> _recvPackets{0};
+    std::atomic<uint64_t> _recvCalls{0};
+    std::atomic<uint64_t> _sendBytes{0};
+    std::atomic<uint64_t> _sendPackets{0};
+    std::atomic<uint64_t> _sendCalls{0};
+};
+
+// 由累计字节数计算速率(bytes/s), 距上次计算不足1秒时返回上次的结果
+class RateMeter {
+  public:
+    int update(uint64_t total) {
+        auto now = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - _lastTime).count();
+        if (elapsed < 1000) {
+            return _rate;
+        }
+        _rate = (int)((total - _lastTotal) * 1000 / elapsed);
+        _lastTotal = total;
+        _lastTime = now;
+        return _rate;
+    }
+
+  private:
+    int _rate{0};
+    uint64_t _lastTotal{0};
+    std::chrono::steady_clock::time_point _lastTime{std::chrono::steady_clock::now()};
+};
+
+} // namespace myNet
+
+#endif // TrafficCounters_hpp
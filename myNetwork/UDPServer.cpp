@@ -36,7 +36,10 @@ namespace myNet {
 UDPServer::UDPServer(const EventPoller::Ptr& poller) : Server(poller) {
     setOnCreateSocket(nullptr);
     _socket = createSocket(_poller);
+    // 数据读入接收slab, 转交其他线程或新会话时无需拷贝
+    _socket->enableRecvSlab();
     _socket->setOnRead([this](const Buffer::Ptr& buf, sockaddr* addr, int addrLen) { onRead(buf, addr, addrLen); });
+    _socket->setServerCounters(getCounters(_poller.get()));
 }
 
 UDPServer::~UDPServer() {
@@ -74,6 +77,8 @@ void UDPServer::cloneFrom(const UDPServer& that) {
     _sessionBuilder = that._sessionBuilder;
     _sessionMtx = that._sessionMtx;
     _sessionMap = that._sessionMap;
+    _counters = that._counters;
+    _socket->setServerCounters(getCounters(_poller.get()));
 
     // clone udp socket
     _socket->bindUdpSocket(that._socket->get_localPort(), that._socket->get_localIP());
@@ -121,10 +126,9 @@ void UDPServer::onRead(const Buffer::Ptr& buf, sockaddr* addr, int addrLen, bool
             WarnL << "UDP packet incoming from other thread.";
             std::weak_ptr<Session> weakSession = session;
 
-            auto tmpBuf = std::make_shared<BufferString>(buf->toString());
-            session->async([weakSession, tmpBuf]() {
+            session->async([weakSession, buf]() {
                 if (auto sharedSession = weakSession.lock()) {
-                    UDPServer::emitSessionRecv(sharedSession, tmpBuf);
+                    UDPServer::emitSessionRecv(sharedSession, buf);
                 }
             });
         }
@@ -145,12 +149,11 @@ void UDPServer::emitSessionRecv(const Session::Ptr& session, const Buffer::Ptr&
     }
 }
 
-const Session::Ptr& UDPServer::getSession(const std::string& peerId, const Buffer::Ptr& buf, sockaddr* addr, int addrLen, bool& isNew) {
+Session::Ptr UDPServer::getSession(const std::string& peerId, const Buffer::Ptr& buf, sockaddr* addr, int addrLen, bool& isNew) {
     {
         std::lock_guard<std::recursive_mutex> lock(*_sessionMtx);
         auto iter = _sessionMap->find(peerId);
         if (iter != _sessionMap->end()) {
-            // warning: returning reference to local temporary object
             return iter->second->getSession();
         }
     }
@@ -159,7 +162,7 @@ const Session::Ptr& UDPServer::getSession(const std::string& peerId, const Buffe
     return createSession(peerId, buf, addr, addrLen);
 }
 
-const Session::Ptr& UDPServer::createSession(const std::string& id, const Buffer::Ptr& buf, sockaddr* addr, int addrLen) {
+Session::Ptr UDPServer::createSession(const std::string& id, const Buffer::Ptr& buf, sockaddr* addr, int addrLen) {
     auto socket = createSocket(_poller, buf, addr, addrLen);
     if (!socket) {
         // UDP 直接丢弃数据
@@ -179,6 +182,8 @@ const Session::Ptr& UDPServer::createSession(const std::string& id, const Buffer
         }
 
         // 否则通过socket 创建session
+        socket->enableRecvSlab();
+        socket->setServerCounters(getCounters(socket->getPoller().get()));
         socket->bindUdpSocket(_socket->get_localPort(), _socket->get_localIP());
         socket->bindPeerAddr(addr, addrLen);
         auto helper = _sessionBuilder(server, socket);
@@ -231,16 +236,14 @@ const Session::Ptr& UDPServer::createSession(const std::string& id, const Buffer
 
     // 若socket 在本线程，直接创建并返回Session
     if (socket->getPoller()->isCurrentThread()) {
-        // warning: returning reference to local temporary object
         return sessionCreater();
     }
 
     // 否则在socket 所在线程创建并处理数据
-    auto tmpBuf = std::make_shared<BufferString>(buf->toString());
-    socket->getPoller()->async([sessionCreater, tmpBuf]() {
+    socket->getPoller()->async([sessionCreater, buf]() {
         auto session = sessionCreater();
         if (session) {
-            emitSessionRecv(session, tmpBuf);
+            emitSessionRecv(session, buf);
         }
     });
 
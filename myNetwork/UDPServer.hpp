@@ -38,10 +38,10 @@ class UDPServer : public Server {
     static void emitSessionRecv(const Session::Ptr& session, const Buffer::Ptr& buf);
 
     // 根据peerId获取Session, 若无就创建一个
-    const Session::Ptr& getSession(const std::string& peerId, const Buffer::Ptr& buf, sockaddr* addr, int addrLen, bool& isNew);
+    Session::Ptr getSession(const std::string& peerId, const Buffer::Ptr& buf, sockaddr* addr, int addrLen, bool& isNew);
 
     // 创建Session
-    const Session::Ptr& createSession(const std::string& id, const Buffer::Ptr& buf, sockaddr* addr, int addrLen);
+    Session::Ptr createSession(const std::string& id, const Buffer::Ptr& buf, sockaddr* addr, int addrLen);
 
     // 创建Socket
     Socket::Ptr createSocket(const EventPoller::Ptr& poller, const Buffer::Ptr& buf = nullptr, sockaddr* addr = nullptr, int addrLen = 0);
@@ -38,6 +38,16 @@ class MutexWrapper {
     std::recursive_mutex _Mtx;
 };
 
+// 空锁, 接口与MutexWrapper 相同, 加解锁在编译期消除
+class NullMutexWrapper {
+  public:
+    NullMutexWrapper(bool) {}
+    ~NullMutexWrapper() = default;
+
+    void lock() {}
+    void unlock() {}
+};
+
 } // namespace myNet
 
 #endif
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "Util/TimeTicker.h"
 
 #define EPOLL_SIZE 1024
+// 发布线程负载的周期
+#define LOAD_PUBLISH_INTERVAL_MS 200
 
 // 转换poller 和epoll 所使用的事件标识符
 #define toEpoll(event) (((event) & Event_Read) ? EPOLLIN : 0) | (((event) & Event_Write) ? EPOLLOUT : 0) | (((event) & Event_Error) ? (EPOLLHUP | EPOLLERR) : 0) | (((event) & Event_LT) ? 0 : EPOLLET)
@@ -68,7 +70,9 @@ int EventPoller::delEvent(int fd, PollDelCB cb) {
     }
 
     if (isCurrentThread()) {
-        bool success = (0 == epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, nullptr) && _eventMap.erase(fd) > 0);
+        // fd 可能已被关闭(会自动从epoll 中移除), 此时epoll_ctl 失败, 但回调仍需删除, 否则复用该fd 的新连接无法注册回调
+        bool success = (0 == epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, nullptr));
+        success = (_eventMap.erase(fd) > 0) && success;
         cb(success);
         return success ? 0 : -1;
     }
@@ -83,7 +87,14 @@ int EventPoller::modifyEvent(int fd, int event) {
     epoll_event epollEvent{0};
     epollEvent.events = toEpoll(event);
     epollEvent.data.fd = fd;
-    return epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &epollEvent);
+    int ret = epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &epollEvent);
+    if (-1 == ret && EINVAL == errno) {
+        // addEvent 以EPOLLEXCLUSIVE 添加的fd 不支持EPOLL_CTL_MOD, 删除后重新添加
+        epollEvent.events |= EPOLLEXCLUSIVE;
+        epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ret = epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &epollEvent);
+    }
+    return ret;
 }
 
 Task::Ptr EventPoller::async(TaskIn task, bool maySync) {
@@ -185,18 +196,25 @@ void EventPoller::runLoop(bool blocked, bool refSelf) {
         }
         _semLoop.post();
         _exitFlag = false;
+        BufferPool::enableThreadCache();
+
+        // 周期性发布负载, 空闲时也会被定时唤醒, 负载能及时回落
+        doDelayTask(LOAD_PUBLISH_INTERVAL_MS, [this]() -> uint64_t {
+            publishLoad();
+            return LOAD_PUBLISH_INTERVAL_MS;
+        });
 
         uint64_t minDelay;
         epoll_event events[EPOLL_SIZE];
         while (!_exitFlag) {
             minDelay = getMinDelay();
+            // 定时任务添加了轮末任务时不休眠, 处理完已就绪的事件后立即执行
+            int timeout = !_loopEndTasks.empty() ? 0 : (minDelay > 0 ? (int)minDelay : -1);
             startSleep();
-            int ret = epoll_wait(_epollFd, events, EPOLL_SIZE, minDelay > 0 ? minDelay : -1);
+            int ret = epoll_wait(_epollFd, events, EPOLL_SIZE, timeout);
             sleepWakeUp();
-            if (ret <= 0) {
-                continue;
-            }
 
+            // 超时或被信号中断时ret <= 0, 不处理事件, 但仍执行轮末任务
             for (int i = 0; i < ret; ++i) {
                 auto& ev = events[i];
                 auto fd = ev.data.fd;
@@ -212,13 +230,35 @@ void EventPoller::runLoop(bool blocked, bool refSelf) {
                     ErrorL << "Exception occurred when do event task: " << e.what();
                 }
             }
+            runLoopEndTasks();
         }
+        // 退出前执行完剩余的轮末任务
+        runLoopEndTasks();
     } else {
         _loopThread = new std::thread(&EventPoller::runLoop, this, true, refSelf);
         _semLoop.wait();
     }
 }
 
+void EventPoller::addLoopEndTask(TaskIn task) {
+    _loopEndTasks.emplace_back(std::move(task));
+}
+
+void EventPoller::runLoopEndTasks() {
+    // 任务中可能再添加任务, 直到全部执行完
+    while (!_loopEndTasks.empty()) {
+        _loopEndRunning.swap(_loopEndTasks);
+        for (auto& task : _loopEndRunning) {
+            try {
+                task();
+            } catch (std::exception& e) {
+                ErrorL << "Exception occurred when do loop end task: " << e.what();
+            }
+        }
+        _loopEndRunning.clear();
+    }
+}
+
 void EventPoller::onPipeEvent() {
     char buf[1024];
     // ET 方式处理数据
@@ -325,4 +365,19 @@ EventPollerPool::EventPollerPool() {
     InfoL << "EventPoller created size: " << size;
 }
 
+AcceptorPollerPool& AcceptorPollerPool::Instance() {
+    static std::shared_ptr<AcceptorPollerPool> sharedRet(new AcceptorPollerPool());
+    static auto& ret = *sharedRet;
+    return ret;
+}
+
+EventPoller::Ptr AcceptorPollerPool::getPoller() {
+    return std::dynamic_pointer_cast<EventPoller>(_threads.front());
+}
+
+AcceptorPollerPool::AcceptorPollerPool() {
+    // 单线程, 不绑定CPU, 让数据poller 独占各自的核
+    addPoller("acceptor poller", 1, ThreadPool::PRIORITY_HIGHEST, true, false);
+}
+
 } // namespace myNet
\ No newline at end of file
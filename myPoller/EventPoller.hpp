@@ -8,8 +8,10 @@
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "../myNetwork/Buffer.hpp"
+#include "../myNetwork/TrafficCounters.hpp"
 #include "../myThread/TaskExecutor.hpp"
 #include "../myThread/ThreadPool.hpp"
 #include "Pipe.hpp"
@@ -52,10 +54,26 @@ class EventPoller : public TaskExecutor, public std::enable_shared_from_this<Eve
 
     bool isCurrentThread();
 
+    // 本轮所有就绪事件处理完后执行, 只能在本poller 线程调用
+    void addLoopEndTask(TaskIn task);
+
     static EventPoller::Ptr getCurrentPoller();
 
     BufferRaw::Ptr getSharedBuffer();
 
+    // 接收slab 分配器, 只能在本poller 线程使用
+    BufferSlabAllocator& getRecvSlab() {
+        return _recvSlab;
+    }
+
+    // 本poller 上所有socket 的收发计数
+    TrafficCounters& getCounters() {
+        return _counters;
+    }
+    TrafficStats getStats() const {
+        return _counters.snapshot();
+    }
+
     const std::thread::id& getThreadId() const;
 
     const std::string& getThreadName() const;
@@ -72,6 +90,9 @@ class EventPoller : public TaskExecutor, public std::enable_shared_from_this<Eve
     // 内部管道事件，用于唤醒轮询线程
     void onPipeEvent();
 
+    // 执行本轮添加的轮末任务
+    void runLoopEndTasks();
+
     // 结束轮询
     void shutdown();
     // 结束信号
@@ -87,6 +108,8 @@ class EventPoller : public TaskExecutor, public std::enable_shared_from_this<Eve
     bool _exitFlag;
     // 当前线程所有Socket 共享的读缓存
     std::weak_ptr<BufferRaw> _sharedBuffer;
+    BufferSlabAllocator _recvSlab;
+    TrafficCounters _counters;
     ThreadPool::Priority _priority;
 
     // 运行循环事件的锁
@@ -103,6 +126,10 @@ class EventPoller : public TaskExecutor, public std::enable_shared_from_this<Eve
     std::mutex _mtxTask;
     std::list<Task::Ptr> _listTask;
 
+    // 轮末任务, 只在本线程访问; 执行时交换到_loopEndRunning, 复用两者的空间
+    std::vector<TaskIn> _loopEndTasks;
+    std::vector<TaskIn> _loopEndRunning;
+
     toolkit::Logger::Ptr _logger;
 
     int _epollFd{-1};
@@ -136,6 +163,20 @@ class EventPollerPool : public std::enable_shared_from_this<EventPollerPool>, pu
     bool _preferCurrentThread{true};
 };
 
+// 专用于accept 的poller, 不属于EventPollerPool, 与数据收发的poller 隔离
+class AcceptorPollerPool : public std::enable_shared_from_this<AcceptorPollerPool>, public TaskExecutorGetter {
+  public:
+    using Ptr = std::shared_ptr<AcceptorPollerPool>;
+    ~AcceptorPollerPool() = default;
+
+    static AcceptorPollerPool& Instance();
+
+    EventPoller::Ptr getPoller();
+
+  private:
+    AcceptorPollerPool();
+};
+
 } // namespace myNet
 
 #endif // EventPoller_hpp
\ No newline at end of file
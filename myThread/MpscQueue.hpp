@@ -0,0 +1,75 @@
+#ifndef MpscQueue_hpp
+#define MpscQueue_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace myNet {
+
+// 多生产者单消费者无锁队列, 无容量限制
+// push 可在任意线程调用, 以CAS 压入链表头; popAll 只能在一个线程调用, 整体取走后按push 顺序回调
+// 消费者整体取走链表, 不存在ABA 问题
+template <typename T> class MpscQueue {
+  public:
+    MpscQueue() = default;
+    ~MpscQueue() {
+        auto node = _head.exchange(nullptr, std::memory_order_acquire);
+        while (node) {
+            auto next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // 返回push 前队列是否为空, 生产者据此只唤醒一次消费者
+    template <typename U> bool push(U&& item) {
+        auto node = new Node{std::forward<U>(item), nullptr};
+        auto head = _head.load(std::memory_order_relaxed);
+        do {
+            node->next = head;
+        } while (!_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+        return head == nullptr;
+    }
+
+    // 取出当前所有元素, 按push 顺序回调, 返回元素个数
+    template <typename FUNC> size_t popAll(FUNC&& func) {
+        auto node = _head.exchange(nullptr, std::memory_order_acquire);
+        // 链表为后进先出, 反转后恢复push 顺序
+        Node* reversed = nullptr;
+        while (node) {
+            auto next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+        size_t count = 0;
+        while (reversed) {
+            auto next = reversed->next;
+            func(std::move(reversed->item));
+            delete reversed;
+            reversed = next;
+            ++count;
+        }
+        return count;
+    }
+
+    bool empty() const {
+        return _head.load(std::memory_order_acquire) == nullptr;
+    }
+
+  private:
+    struct Node {
+        T item;
+        Node* next;
+    };
+
+    std::atomic<Node*> _head{nullptr};
+};
+
+} // namespace myNet
+
+#endif // MpscQueue_hpp
@@ -0,0 +1,75 @@
+#ifndef SpscQueue_hpp
+#define SpscQueue_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace myNet {
+
+// 单生产者单消费者无锁环形队列, 容量向上取整为2的幂
+// push 只能在一个线程调用, pop 只能在另一个线程调用
+template <typename T> class SpscQueue {
+  public:
+    explicit SpscQueue(size_t capacity = 1024) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        _mask = size - 1;
+        _items.reset(new T[size]);
+    }
+    ~SpscQueue() = default;
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // 队列满时返回false
+    template <typename U> bool push(U&& item) {
+        auto tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _headCache > _mask) {
+            _headCache = _head.load(std::memory_order_acquire);
+            if (tail - _headCache > _mask) {
+                return false;
+            }
+        }
+        _items[tail & _mask] = std::forward<U>(item);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 队列空时返回false
+    bool pop(T& item) {
+        auto head = _head.load(std::memory_order_relaxed);
+        if (head == _tailCache) {
+            _tailCache = _tail.load(std::memory_order_acquire);
+            if (head == _tailCache) {
+                return false;
+            }
+        }
+        item = std::move(_items[head & _mask]);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return _mask + 1;
+    }
+
+  private:
+    size_t _mask;
+    std::unique_ptr<T[]> _items;
+
+    // 生产者和消费者各自使用的变量放在不同缓存行, 避免伪共享
+    alignas(64) std::atomic<size_t> _tail{0};
+    size_t _headCache{0};
+    alignas(64) std::atomic<size_t> _head{0};
+    size_t _tailCache{0};
+};
+
+} // namespace myNet
+
+#endif // SpscQueue_hpp
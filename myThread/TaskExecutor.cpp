@@ -1,5 +1,7 @@
 #include "TaskExecutor.hpp"
 
+#include <algorithm>
+#include <ctime>
 #include <thread>
 
 #include "../myPoller/EventPoller.hpp"
@@ -9,66 +11,112 @@
 
 namespace myNet {
 
+static std::atomic<bool> s_enableCpuTime{false};
+
+// 本线程上次唤醒时的CPU 时间, 线程池多个线程共用一个计数器时各自统计
+static thread_local uint64_t s_wakeCpuTime = 0;
+
+static uint64_t getThreadCpuMicrosecond() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
 ThreadLoadCounter::ThreadLoadCounter(uint64_t maxSize, uint64_t windowSize) {
-    _lastSleepTime = _lastWakeTime = toolkit::getCurrentMicrosecond();
-    _maxSize = maxSize;
+    uint64_t size = 2;
+    while (size < maxSize) size <<= 1;
+    _mask = size - 1;
+    _samples.reset(new Sample[size]);
     _windowSize = windowSize;
+    _useCpuTime = s_enableCpuTime.load();
+    _lastSleepTime = _lastWakeTime = toolkit::getCurrentMicrosecond();
+}
+
+void ThreadLoadCounter::setEnableCpuTime(bool enable) {
+    s_enableCpuTime = enable;
+}
+
+void ThreadLoadCounter::beginWrite() {
+    // 事件循环只有一个写入方, 这里不会自旋; 线程池多个线程共用时互斥写入
+    auto seq = _seq.load(std::memory_order_relaxed);
+    while ((seq & 1) || !_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+        seq = _seq.load(std::memory_order_relaxed);
+    }
+}
+
+void ThreadLoadCounter::endWrite() {
+    _seq.fetch_add(1, std::memory_order_release);
 }
 
 void ThreadLoadCounter::startSleep() {
-    LOCK_GUDAR lck(_mtx);
-    _sleeping = true;
-    _lastSleepTime = toolkit::getCurrentMicrosecond();
-    _timeRecordList.emplace_back(_lastSleepTime - _lastWakeTime, false);
-    if (_timeRecordList.size() > _maxSize) {
-        _timeRecordList.pop_front();
+    auto now = toolkit::getCurrentMicrosecond();
+    uint64_t busy = 0;
+    if (_useCpuTime) {
+        auto cpu = getThreadCpuMicrosecond();
+        busy = s_wakeCpuTime ? cpu - s_wakeCpuTime : 0;
     }
+
+    beginWrite();
+    auto lastSleep = _lastSleepTime.load(std::memory_order_relaxed);
+    auto lastWake = _lastWakeTime.load(std::memory_order_relaxed);
+    // 一个样本为上次休眠开始到本次休眠开始: 休眠 + 运行
+    auto total = now > lastSleep ? now - lastSleep : 0;
+    if (!_useCpuTime) {
+        busy = now > lastWake ? now - lastWake : 0;
+    }
+    auto& sample = _samples[_count.load(std::memory_order_relaxed) & _mask];
+    sample.busy.store(std::min(busy, total), std::memory_order_relaxed);
+    sample.total.store(total, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _lastSleepTime.store(now, std::memory_order_relaxed);
+    _sleeping.store(true, std::memory_order_relaxed);
+    endWrite();
 }
 
 void ThreadLoadCounter::sleepWakeUp() {
-    LOCK_GUDAR lck(_mtx);
-    _sleeping = false;
-    _lastWakeTime = toolkit::getCurrentMicrosecond();
-    _timeRecordList.emplace_back(_lastWakeTime - _lastSleepTime, true);
-    if (_timeRecordList.size() > _maxSize) {
-        _timeRecordList.pop_front();
+    if (_useCpuTime) {
+        s_wakeCpuTime = getThreadCpuMicrosecond();
     }
+    beginWrite();
+    _lastWakeTime.store(toolkit::getCurrentMicrosecond(), std::memory_order_relaxed);
+    _sleeping.store(false, std::memory_order_relaxed);
+    endWrite();
 }
 
 int ThreadLoadCounter::getLoad() {
-    LOCK_GUDAR lck(_mtx);
-    uint64_t totalSleepTime = 0;
-    uint64_t totalRunTime = 0;
-
-    for (auto& [tme, isSleeping] : _timeRecordList) {
-        if (isSleeping) {
-            totalSleepTime += tme;
+    uint64_t totalRunTime, totalTime;
+    uint64_t seq;
+    do {
+        seq = _seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        totalRunTime = totalTime = 0;
+
+        // 当前未结束的休眠或运行时间
+        auto now = toolkit::getCurrentMicrosecond();
+        auto lastSleep = _lastSleepTime.load(std::memory_order_relaxed);
+        auto lastWake = _lastWakeTime.load(std::memory_order_relaxed);
+        if (_sleeping.load(std::memory_order_relaxed)) {
+            totalTime = now > lastSleep ? now - lastSleep : 0;
         } else {
-            totalRunTime += tme;
+            totalTime = now > lastSleep ? now - lastSleep : 0;
+            totalRunTime = now > lastWake ? now - lastWake : 0;
         }
-    }
-
-    if (_sleeping) {
-        totalSleepTime += toolkit::getCurrentMicrosecond() - _lastSleepTime;
-    } else {
-        totalRunTime += toolkit::getCurrentMicrosecond() - _lastSleepTime;
-    }
 
-    // 判断是否大于时间窗
-    uint64_t totalTime = totalRunTime + totalSleepTime;
-    while (!_timeRecordList.empty() && totalTime > _windowSize) {
-        auto [tme, isSleeping] = _timeRecordList.front();
-        _timeRecordList.pop_front();
-        if (isSleeping) {
-            totalSleepTime -= tme;
-        } else {
-            totalRunTime -= tme;
+        // 从最新的样本往前累加, 超出时间窗即停止
+        auto count = _count.load(std::memory_order_relaxed);
+        auto size = std::min<uint64_t>(count, _mask + 1);
+        for (uint64_t i = 1; i <= size && totalTime < _windowSize; ++i) {
+            auto& sample = _samples[(count - i) & _mask];
+            totalRunTime += sample.busy.load(std::memory_order_relaxed);
+            totalTime += sample.total.load(std::memory_order_relaxed);
         }
-        totalTime -= tme;
-    }
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != _seq.load(std::memory_order_relaxed));
 
     if (totalTime != 0) {
-        return totalRunTime * 100 / totalTime;
+        return std::min<uint64_t>(totalRunTime * 100 / totalTime, 100);
     }
     return 0;
 }
@@ -98,16 +146,23 @@ void TaskExecutorInterface::sync_first(const TaskIn task) {
 }
 
 TaskExecutor::Ptr TaskExecutorGetter::getExecutor() {
-    size_t retPos = 0;
-    int minLoad = 100;
-    for (auto i = 0; i < _threads.size(); ++i) {
-        auto tmpLoad = _threads[i]->getLoad();
-        if (minLoad > tmpLoad) {
-            minLoad = tmpLoad;
-            retPos = i;
-        }
+    auto size = _threads.size();
+    if (size == 1) {
+        return _threads[0];
     }
-    return _threads[retPos];
+
+    // xorshift 伪随机数, 每个线程独立, 无需加锁
+    static thread_local uint64_t seed = (toolkit::getCurrentMicrosecond() ^ std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+
+    // power of two choices: 不必遍历所有线程, 效果接近取最小值
+    size_t first = seed % size;
+    size_t second = (first + 1 + (seed >> 32) % (size - 1)) % size;
+    auto& a = _threads[first];
+    auto& b = _threads[second];
+    return a->getCachedLoad() <= b->getCachedLoad() ? a : b;
 }
 
 void TaskExecutorGetter::getExecutorDelay(const std::function<void(const std::vector<int>&)>& callback) {
@@ -2,7 +2,7 @@
 #define TaskExecutor_hpp
 
 // #include <functional>
-#include <list>
+#include <atomic>
 #include <memory>
 #include <mutex>
 
@@ -12,12 +12,19 @@ namespace myNet {
 
 // 时间管理暂时未实现，先使用ZLToolkit 实现的相关内容
 // ticker
+// 每轮循环记录一个{运行时间, 总时间}样本到固定大小的环形数组
+// 写入方不加锁, 读取方通过序列号(seqlock) 获取一致的快照, 不会阻塞写入方
 class ThreadLoadCounter {
   public:
+    // maxSize: 样本数量上限(向上取整为2的幂)
     // windowSize: 统计的时间窗口大小
     ThreadLoadCounter(uint64_t maxSize, uint64_t windowSize);
     ~ThreadLoadCounter() = default;
 
+    // 使用线程CPU 时间(CLOCK_THREAD_CPUTIME_ID) 统计运行时间, 被抢占的时间不计入负载
+    // 需在创建线程池之前设置
+    static void setEnableCpuTime(bool enable);
+
     // 线程进入休眠
     void startSleep();
 
@@ -27,18 +34,39 @@ class ThreadLoadCounter {
     // 获取当前线程负载(0-100)
     int getLoad();
 
+    // 统计当前负载并发布到缓存, 由线程自身周期性调用
+    void publishLoad() {
+        _cachedLoad.store(getLoad(), std::memory_order_relaxed);
+    }
+
+    // 获取最近一次发布的负载, 无锁
+    int getCachedLoad() const {
+        return _cachedLoad.load(std::memory_order_relaxed);
+    }
+
   private:
-    using LOCK_GUDAR = std::lock_guard<std::mutex>;
-    std::mutex _mtx;
+    struct Sample {
+        std::atomic<uint64_t> busy{0};
+        std::atomic<uint64_t> total{0};
+    };
 
-    bool _sleeping{true};
-    uint64_t _lastSleepTime;
-    uint64_t _lastWakeTime;
-    uint64_t _maxSize;
+    // 写入前后各递增一次序列号, 奇数表示正在写入
+    void beginWrite();
+    void endWrite();
+
+    bool _useCpuTime;
+    uint64_t _mask;
     uint64_t _windowSize;
+    std::unique_ptr<Sample[]> _samples;
+
+    std::atomic<uint64_t> _seq{0};
+    std::atomic<uint64_t> _count{0};
+    std::atomic<bool> _sleeping{true};
+    std::atomic<uint64_t> _lastSleepTime;
+    std::atomic<uint64_t> _lastWakeTime;
 
-    // <时间， 是否休眠>
-    std::list<std::pair<uint64_t, bool>> _timeRecordList;
+    // 独占缓存行, 避免其他线程读取时与本线程的统计数据伪共享
+    alignas(64) std::atomic<int> _cachedLoad{0};
 };
 
 template <typename R, typename... ArgTypes> class TaskCancelable;
@@ -125,15 +153,15 @@ class TaskExecutorGetter {
     TaskExecutorGetter() = default;
     ~TaskExecutorGetter() = default;
 
-    // 获取最闲的线程
+    // 获取较闲的线程: 随机取两个线程, 返回缓存负载较低的一个
     TaskExecutor::Ptr getExecutor();
 
-    // 获取线程负载
+    // 获取线程负载(各线程最近一次发布的值)
     std::vector<int> getExecutorLoad() {
         std::vector<int> vec(_threads.size());
         int i = 0;
         for (auto& executor : _threads) {
-            vec[i++] = executor->getLoad();
+            vec[i++] = executor->getCachedLoad();
         }
         return vec;
     }
@@ -0,0 +1,90 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../myNetwork/TCPServer.hpp"
+#include "Util/TimeTicker.h"
+#include "Util/logger.h"
+
+using namespace std;
+using namespace myNet;
+
+// 对比两种accept 模式下的建连吞吐: 每个客户端连接发送1字节, 收到回显后立即RST 关闭
+// Cloned: 每个poller 克隆监听socket 各自accept
+// Acceptor: 专用accept 线程批量accept, 通过无锁队列分发fd
+
+static atomic_llong sessionCount(0);
+
+class PingSession : public Session {
+  public:
+    PingSession(const Socket::Ptr& sock) : Session(sock) {
+        ++sessionCount;
+    }
+    void onRecv(const Buffer::Ptr& buffer) override {
+        SocketSender::send(buffer->toString());
+    }
+    void onErr(const SocketException& err) override {}
+    void onManager() override {}
+};
+
+static int connectOnce(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    char c = 'x';
+    int ret = (send(fd, &c, 1, 0) == 1 && recv(fd, &c, 1, 0) == 1) ? 0 : -1;
+    // RST 关闭, 避免大量TIME_WAIT 耗尽端口
+    linger lg{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    close(fd);
+    return ret;
+}
+
+static void bench(TCPServer::AcceptMode mode, const char* name, uint16_t port, int clients, int perClient) {
+    TCPServer::Ptr server(new TCPServer);
+    server->setAcceptMode(mode);
+    server->start<PingSession>(port);
+
+    sessionCount = 0;
+    atomic_int failed(0);
+    toolkit::Ticker ticker;
+    vector<thread> threads;
+    for (int i = 0; i < clients; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < perClient; ++j) {
+                if (connectOnce(port) != 0) ++failed;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto ms = ticker.elapsedTime();
+    auto total = clients * perClient;
+    InfoL << name << " 模式: " << total << " 次建连耗时:" << ms << "ms, 失败:" << failed << ", 会话数:" << sessionCount
+          << ", 每秒建连数:" << (ms ? total * 1000 / ms : 0);
+}
+
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    // 初始化日志系统
+    toolkit::Logger::Instance().add(std::make_shared<toolkit::ConsoleChannel>());
+
+    int clients = 16, perClient = 1000;
+    bench(TCPServer::AcceptMode::Cloned, "Cloned", 9101, clients, perClient);
+    bench(TCPServer::AcceptMode::Acceptor, "Acceptor", 9102, clients, perClient);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "../myNetwork/TCPServer.hpp"
+#include "../myThread/Semaphore.hpp"
+#include "Util/TimeTicker.h"
+#include "Util/logger.h"
+
+using namespace std;
+using namespace myNet;
+
+// 统计发送路径上每条消息的operator new 次数
+// 对比: BufferString(每条消息分配string 和对象) 与 BufferRaw(内存池)
+
+static atomic_llong newCount(0);
+
+void* operator new(size_t size) {
+    ++newCount;
+    if (auto ptr = malloc(size)) return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+static atomic_llong recvBytes(0);
+
+class SinkSession : public Session {
+  public:
+    SinkSession(const Socket::Ptr& sock) : Session(sock) {}
+    void onRecv(const Buffer::Ptr& buffer) override {
+        recvBytes += buffer->size();
+    }
+    void onErr(const SocketException& err) override {}
+    void onManager() override {}
+};
+
+static void bench(const Socket::Ptr& sock, const char* name, int count, const std::function<void(const char*, size_t)>& sender) {
+    char msg[128];
+    memset(msg, 'x', sizeof(msg));
+
+    // 先发送一批预热内存池
+    sock->getPoller()->sync([&]() {
+        for (int i = 0; i < 1000; ++i) sender(msg, sizeof(msg));
+        sock->flushAll();
+    });
+    sleep(1);
+
+    recvBytes = 0;
+    toolkit::Ticker ticker;
+    long long news = 0;
+    sock->getPoller()->sync([&]() {
+        auto begin = newCount.load();
+        for (int i = 0; i < count; ++i) {
+            sender(msg, sizeof(msg));
+            // 每64条消息刷新一次, 释放已发送的缓存
+            if (i % 64 == 63) sock->flushAll();
+        }
+        sock->flushAll();
+        news = newCount.load() - begin;
+    });
+    while (recvBytes < (long long)(count * sizeof(msg)) && ticker.elapsedTime() < 10 * 1000) {
+        usleep(1000);
+    }
+    InfoL << name << ": 发送" << count << "条消息耗时:" << ticker.elapsedTime() << "ms, 每条消息operator new 次数:" << (double)news / count;
+}
+
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    // 初始化日志系统
+    toolkit::Logger::Instance().add(std::make_shared<toolkit::ConsoleChannel>());
+
+    TCPServer::Ptr server(new TCPServer);
+    server->start<SinkSession>(9103);
+
+    Semaphore sem;
+    auto sock = Socket::createSocket(EventPollerPool::Instance().getPoller(false), false);
+    sock->connect("127.0.0.1", 9103, [&](const SocketException& err) { sem.post(); });
+    sem.wait();
+
+    int count = 100000;
+    bench(sock, "BufferString", count, [&](const char* data, size_t size) { sock->send(std::make_shared<BufferString>(std::string(data, size)), nullptr, 0, false); });
+    bench(sock, "BufferRaw", count, [&](const char* data, size_t size) { sock->send(data, size, nullptr, 0, false); });
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <vector>
+
+#include "../myNetwork/TCPServer.hpp"
+#include "../myThread/Semaphore.hpp"
+#include "Util/logger.h"
+
+using namespace std;
+using namespace myNet;
+
+// ping-pong 延迟测试: 客户端发送64字节, 服务端原样返回, 收到后立即发送下一个
+// 对比: 直接发送(队列为空时直接写入socket) 与 经过发送队列
+
+static atomic_bool directSend(true);
+
+class EchoSession : public Session {
+  public:
+    EchoSession(const Socket::Ptr& sock) : Session(sock) {
+        sock->enableSendDirect(directSend);
+    }
+    void onRecv(const Buffer::Ptr& buffer) override {
+        send(buffer);
+    }
+    void onErr(const SocketException& err) override {}
+    void onManager() override {}
+};
+
+static void bench(const char* name, int rounds) {
+    directSend = strcmp(name, "直接发送") == 0;
+
+    Semaphore sem;
+    auto sock = Socket::createSocket(EventPollerPool::Instance().getPoller(false), false);
+    sock->enableSendDirect(directSend);
+    sock->connect("127.0.0.1", 9105, [&](const SocketException& err) { sem.post(); });
+    sem.wait();
+
+    char msg[64];
+    memset(msg, 'x', sizeof(msg));
+    vector<int64_t> rtts;
+    rtts.reserve(rounds);
+    size_t received = 0;
+    auto start = chrono::steady_clock::now();
+    sock->setOnRead([&](const Buffer::Ptr& buf, sockaddr*, int) {
+        received += buf->size();
+        if (received < sizeof(msg)) {
+            return;
+        }
+        received -= sizeof(msg);
+        auto now = chrono::steady_clock::now();
+        rtts.push_back(chrono::duration_cast<chrono::nanoseconds>(now - start).count());
+        if ((int)rtts.size() == rounds) {
+            sem.post();
+            return;
+        }
+        start = now;
+        sock->send(msg, sizeof(msg));
+    });
+    sock->getPoller()->async([&]() {
+        start = chrono::steady_clock::now();
+        sock->send(msg, sizeof(msg));
+    });
+    sem.wait();
+    sock->getPoller()->sync([&]() { sock->closeSocket(); });
+
+    sort(rtts.begin(), rtts.end());
+    InfoL << name << ": " << rounds << "次往返, p50:" << rtts[rtts.size() / 2] / 1000.0 << "us, p99:" << rtts[rtts.size() * 99 / 100] / 1000.0 << "us";
+}
+
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    // 初始化日志系统
+    toolkit::Logger::Instance().add(std::make_shared<toolkit::ConsoleChannel>());
+
+    TCPServer::Ptr server(new TCPServer);
+    server->start<EchoSession>(9105);
+
+    int rounds = 50000;
+    bench("队列发送", rounds);
+    bench("直接发送", rounds);
+    return 0;
+}
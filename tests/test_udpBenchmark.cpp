@@ -0,0 +1,78 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "../myNetwork/Socket.hpp"
+#include "Util/TimeTicker.h"
+#include "Util/logger.h"
+
+using namespace std;
+using namespace myNet;
+
+// udp 发包速率测试: 每个数据报通过BufferSock 指定目标地址
+// 逐包: 每个数据报立即flush, 每次sendmmsg 只发送一个数据报
+// 批量: 每batch 个数据报flush 一次, 一次sendmmsg 发送整批
+// 批量+GSO: 连续的等长数据报合并为一个消息, 由内核分段
+
+static atomic_llong recvCount(0);
+
+static void bench(const Socket::Ptr& sock, sockaddr_in& peer, const char* name, int count, int batch) {
+    char msg[64];
+    memset(msg, 'x', sizeof(msg));
+
+    recvCount = 0;
+    toolkit::Ticker ticker;
+    sock->getPoller()->sync([&]() {
+        for (int i = 0; i < count; ++i) {
+            sock->send(msg, sizeof(msg), (sockaddr*)&peer, sizeof(peer), false);
+            if (i % batch == batch - 1) sock->flushAll();
+        }
+        sock->flushAll();
+    });
+    auto elapsed = ticker.elapsedTime();
+    // 等待接收端读完
+    usleep(200 * 1000);
+    InfoL << name << ": 发送" << count << "个数据报耗时:" << elapsed << "ms, 发包速率:" << (elapsed ? count * 1000LL / elapsed : 0) << "pps, 接收:" << recvCount;
+}
+
+int main() {
+    signal(SIGINT, [](int) { exit(0); });
+    // 初始化日志系统
+    toolkit::Logger::Instance().add(std::make_shared<toolkit::ConsoleChannel>());
+
+    // 接收端
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int rcvBuf = 32 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+    sockaddr_in peer{};
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(9104);
+    peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (sockaddr*)&peer, sizeof(peer)) != 0) {
+        ErrorL << "bind 9104 失败";
+        return -1;
+    }
+    thread receiver([fd]() {
+        char buf[2048];
+        while (recv(fd, buf, sizeof(buf), 0) > 0) ++recvCount;
+    });
+    receiver.detach();
+
+    auto sock = Socket::createSocket(EventPollerPool::Instance().getPoller(false), false);
+    sock->bindUdpSocket(0, "0.0.0.0");
+
+    int count = 200000;
+    bench(sock, peer, "逐包", count, 1);
+    bench(sock, peer, "批量", count, 256);
+    if (sock->enableUdpGso()) {
+        bench(sock, peer, "批量+GSO", count, 256);
+    } else {
+        WarnL << "内核不支持UDP_SEGMENT";
+    }
+    return 0;
+}